@@ -1,6 +1,38 @@
+// Compile with: gcc -O2 practica_8.c -o practica_8 -lm -pthread
+// Batch mode:   ./practica_8 --lote [guion]   (one report per line, see lote)
+// Server:       ./practica_8 --servidor [socket]   (batch commands over a Unix socket, cached; see servidor)
+// Streaming:    ./practica_8 --streaming anyo_inicio anyo_fin [MiB]   (bounded memory, see streaming)
+// Sites:        ./practica_8 --sitios anyo_inicio anyo_fin sitio1.txt sitio2.txt ...   (one bank per file, see sitios)
+// Benchmark:    ./practica_8 --benchmark [filas ...]   (synthetic inventory: ./practica_8 --genera filas [fichero] [semilla])
+// Metrics:      SEMILLAS_METRICAS=metricas.json ./practica_8   (.prom for Prometheus text; SEMILLAS_PERF=1 adds hardware counters)
+
+#define _GNU_SOURCE // POSIX and Linux interfaces (mmap, sockets, perf_event, wait4) under -std=c11
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
-#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
 
 /*
     * Datos del fichero "semillas.txt":
@@ -61,9 +93,13 @@
 
 //! --------------------- CONSTANTS --------------------- 
 
-//* Number of types of seeds in the bank
+//* Initial number of types of seeds in the bank (the bank grows if semillas.txt has more)
 #define N_SEMILLAS 7000 // Número de tipos de semillas del banco
-// Related array: All arrays are of size N_SEMILLAS (e.g., vAnyo, vCaducidad, etc.).
+// Related struct: BancoSemillas (all its arrays start with room for N_SEMILLAS seeds).
+
+//* Highest identifier accepted (the bank has a slot per identifier, so this bounds its size)
+#define MAX_IDENTIFICADOR 100000000 // About 1.1 GB of columns; a higher id is a value out of range
+// Related function: campos_validos. Related constant: BENCH_MAX_FILAS.
 
 //* Number of sections in the bank
 #define N_SECCIONES 100 // Número de secciones del banco
@@ -75,14 +111,14 @@
 #define RIESGO_MEDIO 3   // Nivel medio de peligro de extinción
 #define RIESGO_BAJO 4    // Nivel bajo de peligro de extinción
 #define SIN_RIESGO 5     // Sin riesgo de extinción
-// Related array: vRiesgo (stores the extinction risk level of each seed).
+// Related array: vCategorias (stores the extinction risk level of each seed in its bits DESPL_RIESGO).
 
 //* Plant types by growth
 #define ARBOL 1              // Constantes que definen el tipo de planta según su crecimiento - Árbol
 #define ARBUSTO 2            // Arbusto
 #define HIERBA 3             // Hierba
 #define PLANTA_TREPADORA 4   // Planta trepadora
-// Related array: vTipoCrecimiento (stores the growth type of each seed).
+// Related array: vCategorias (stores the growth type of each seed in its bits DESPL_CRECIMIENTO).
 
 //! My Constants:
 #define NUM_OF_TYPES_OF_SEEDS 4
@@ -91,77 +127,782 @@
 //* Plant types by reproduction
 #define CON_FLORES 1  // Constantes que definen el tipo de planta según reproducción - Con flores
 #define SIN_FLORES 2  // Sin flores
-// Related array: vTipoReproduccion (stores the reproduction type of each seed).
+// Related array: vCategorias (stores the reproduction type of each seed in its bits DESPL_REPRODUCCION).
 
 //* Plant types by environmental adaptation
 #define DESERTICAS 1  // Constantes que definen los tipos de plantas según la adaptación al ambiente - Desérticas
 #define VIVEN_AGUA 2  // Viven en agua
 #define SALINAS 3     // Salinas
 #define OTROS 4       // Otros
-// Related array: vTipoAdaptacion (stores the environmental adaptation type of each seed).
+// Related array: vCategorias (stores the environmental adaptation type of each seed in its bits DESPL_ADAPTACION).
 
 //* Plant types by life cycle
 #define ANUALES 1     // Constantes que definen los tipos de plantas según ciclo de la vida - Anuales
 #define BIENALES 2    // Bienales
 #define PERENNES 3    // Perennes
-// Related array: vTipoCiclo (stores the life cycle type of each seed).
+// Related array: vCategorias (stores the life cycle type of each seed in its bits DESPL_CICLO).
+
+//* Marks a slot of the bank with no seed (no line of semillas.txt uses that identifier)
+#define SLOT_VACIO 0
+// Related array: vCategorias (a slot is empty when its whole word is SLOT_VACIO).
+
+//* Bit fields of vCategorias: the five categorical fields of a seed packed in one 16-bit word
+//* The values are kept as they are (not 0-based), so a seed never packs to SLOT_VACIO and a
+//* filter on several fields is one mask and one comparison on the word.
+#define DESPL_RIESGO 0          // Bits 0-2: risk level (1..5)
+#define DESPL_CRECIMIENTO 3     // Bits 3-5: growth type (1..4)
+#define DESPL_REPRODUCCION 6    // Bits 6-7: reproduction type (1..2)
+#define DESPL_ADAPTACION 8      // Bits 8-10: adaptation type (1..4)
+#define DESPL_CICLO 11          // Bits 11-12: life cycle type (1..3)
+#define MASCARA_RIESGO (7 << DESPL_RIESGO)
+#define MASCARA_CRECIMIENTO (7 << DESPL_CRECIMIENTO)
+#define MASCARA_REPRODUCCION (3 << DESPL_REPRODUCCION)
+#define MASCARA_ADAPTACION (7 << DESPL_ADAPTACION)
+#define MASCARA_CICLO (3 << DESPL_CICLO)
+//* Value of one field of a packed word, e.g. CATEGORIA(c, RIESGO)
+#define CATEGORIA(c, campo) (((c) & MASCARA_##campo) >> DESPL_##campo)
+//* Packed word of a seed from its five values
+#define EMPAQUETA(riesgo, crecimiento, reproduccion, adaptacion, ciclo)                              \
+    ((uint16_t) ((riesgo) << DESPL_RIESGO | (crecimiento) << DESPL_CRECIMIENTO |                   \
+                 (reproduccion) << DESPL_REPRODUCCION | (adaptacion) << DESPL_ADAPTACION | (ciclo) << DESPL_CICLO))
+// Related array: vCategorias.
+
+//* Number of biomes in the bank (the biome of a seed is its section % 10)
+#define N_BIOMAS 10
+// Related array: vSeccion.
+
+//* Seed donation rules: minister criteria and UPV restrictions
+#define DONACION_PORCENTAJE 17      // Percentage of the sample that is donated
+#define DONACION_MIN_SEMILLAS 1000  // Restriction 2: minimum sample in the bank
+#define DONACION_MIN_CADUCIDAD 2030 // Restriction 3: minimum expiration year
+#define DONACION_MIN_RESTANTES 500  // Restriction 4: minimum seeds left after donating
+// Smallest sample that keeps DONACION_MIN_RESTANTES seeds after donating (restriction 4 as an integer test)
+#define DONACION_UMBRAL_RESTANTES ((DONACION_MIN_RESTANTES * 100 + (99 - DONACION_PORCENTAJE)) / (100 - DONACION_PORCENTAJE))
+// Minister criteria (biennial, without flowers, other adaptation) as a mask and value of vCategorias
+#define MASCARA_MINISTERIO (MASCARA_CICLO | MASCARA_REPRODUCCION | MASCARA_ADAPTACION)
+#define CRITERIO_MINISTERIO (BIENALES << DESPL_CICLO | SIN_FLORES << DESPL_REPRODUCCION | OTROS << DESPL_ADAPTACION)
+// Related struct: FiltroDonacion.
+
+//* Reports that can be computed together in one pass over the bank (see recorre_banco)
+//* Seed expiration is not scanned: it is answered by IndiceCaducidad.
+#define INFORME_PELIGRO 1     // Seeds in danger of extinction
+#define INFORME_BIOMA 2       // Biome with the highest percentage of species
+#define INFORME_DONACION 4    // Seed donation
+#define TODOS_LOS_INFORMES (INFORME_PELIGRO | INFORME_BIOMA | INFORME_DONACION)
+
+//* Worker threads for the scans over the bank
+#define MAX_HILOS 256                 // Maximum number of worker threads
+#define MIN_SEMILLAS_POR_HILO 65536   // Below this many seeds per thread the threads cost more than they save
+#define MIN_BYTES_POR_LINEA 25        // Shortest line of semillas.txt with four-digit years
+// Related variable: num_hilos (threads requested, from SEMILLAS_HILOS or the number of CPUs).
+
+//* Buffers of the report writers (caducadas.txt, bioma.txt, donadas.txt, nodonadas.txt)
+#define TAM_BUFFER_INFORME (1 << 20)   // Bytes buffered before each write to a report file
+#define TAM_BUFFER_MEMORIA (64 << 10)  // Initial size of the in-memory text of each thread
+// Related struct: Escritor.
+
+//* Binary snapshot of the bank, written after parsing semillas.txt and mapped on later starts
+#define FICHERO_SNAPSHOT "semillas.bin"
+#define SNAPSHOT_VERSION 3       // Changes whenever the layout of the snapshot changes
+#define SNAPSHOT_ALINEACION 64   // Every column starts at a multiple of this offset
+// Related struct: CabeceraSnapshot.
+
+//* Number of arrays (columns) of the bank
+#define N_COLUMNAS 5
+
+//* Streaming mode for banks bigger than memory (see streaming)
+#define MEMORIA_STREAMING_MIB 256          // Default memory budget (SEMILLAS_MEMORIA_MIB or the command line change it)
+#define TAM_BLOQUE_STREAMING (4 << 20)     // Size of each of the two read-ahead blocks
+#define BYTES_POR_SLOT_STREAMING 16        // Memory per slot of a window: columns, expiration index and donation bitmaps
+#define MAX_LINEA_STREAMING 256            // Longest line of semillas.txt that can be cut between two blocks
+
+//* Most inventory files of --sitios, each loaded by its own thread (see sitios)
+#define MAX_SITIOS 64
+
+//* Most words in one line of a batch script (see lote)
+#define MAX_PALABRAS_LOTE 16
+
+//* Query server over a Unix socket (see servidor)
+#define SOCKET_SERVIDOR "semillas.sock"  // Default path of the socket
+#define MAX_CLIENTES_SERVIDOR 32         // Connections served at the same time
+#define MAX_LINEA_SERVIDOR 1024          // Longest request line
+#define MAX_ENTRADAS_CACHE 256           // Responses kept; the least recently used one is replaced
+// Related struct: CacheRespuestas.
+
+//* Benchmark over synthetic inventories (see benchmark)
+#define BENCH_FICHERO "bench_semillas.txt"  // Synthetic inventory of each size (removed once loaded)
+#define BENCH_SEMILLA 2024                  // Default seed of the generator, so every run sees the same data
+#define BENCH_REPETICIONES 3                // Runs of each report; the fastest one is printed
+#define BENCH_MAX_FILAS MAX_IDENTIFICADOR    // Biggest inventory the generator writes (ids 1..filas)
+
+//* Categorical fields with a bitmap per value (see IndiceBitmaps)
+#define CAMPO_RIESGO 0        // CATEGORIA(c, RIESGO) (values 1..5)
+#define CAMPO_CRECIMIENTO 1   // CATEGORIA(c, CRECIMIENTO) (values 1..4)
+#define CAMPO_REPRODUCCION 2  // CATEGORIA(c, REPRODUCCION) (values 1..2)
+#define CAMPO_ADAPTACION 3    // CATEGORIA(c, ADAPTACION) (values 1..4)
+#define CAMPO_CICLO 4         // CATEGORIA(c, CICLO) (values 1..3)
+#define CAMPO_BIOMA 5         // Biome, vSeccion % 10 (values 1..10, biome 1 is index 0)
+#define N_CAMPOS 6
+#define MAX_VALORES_CAMPO N_BIOMAS // Values of the field with the most values
+// Related struct: Consulta.
+
+//* Sort keys of the ordered listings (see ordena_listado), each with its direction
+#define ORDEN_CADUCIDAD 0     // Expiration year, soonest first
+#define ORDEN_RESTANTES 1     // Seeds left after donating, most first
+#define ORDEN_MUESTRA 2       // Seeds in the sample, most first
+#define ORDEN_SECCION 3       // Section of the bank, lowest first
+#define N_ORDENES 4
+#define FRACCION_MONTICULO 8  // A top-K of at most 1/8 of the candidates uses a heap; bigger ones sort them all
+// Related struct: ListadoOrdenado.
+
+//* Dense cube of counts over every categorical field (in the order of CAMPO_*)
+#define CUBO_CELDAS (SIN_RIESGO * PLANTA_TREPADORA * SIN_FLORES * OTROS * PERENNES * N_BIOMAS) // Cells of each slice (9600)
+#define MAX_ANYOS_CUBO 256    // Widest range of expiration years with a slice per year
+// Related struct: Cubo.
+
+//* Keys of the count tables: 0-based value of the seed with index i of bank b, number of values
+//* and names of the values
+#define CLAVE_riesgo(b, i) (CATEGORIA((b)->vCategorias[i], RIESGO) - 1)
+#define CARD_riesgo SIN_RIESGO
+#define NOMBRES_riesgo riesgo_names
+#define CLAVE_crecimiento(b, i) (CATEGORIA((b)->vCategorias[i], CRECIMIENTO) - 1)
+#define CARD_crecimiento PLANTA_TREPADORA
+#define NOMBRES_crecimiento crecimiento_names
+#define CLAVE_reproduccion(b, i) (CATEGORIA((b)->vCategorias[i], REPRODUCCION) - 1)
+#define CARD_reproduccion SIN_FLORES
+#define NOMBRES_reproduccion reproduccion_names
+#define CLAVE_adaptacion(b, i) (CATEGORIA((b)->vCategorias[i], ADAPTACION) - 1)
+#define CARD_adaptacion OTROS
+#define NOMBRES_adaptacion adaptacion_names
+#define CLAVE_ciclo(b, i) (CATEGORIA((b)->vCategorias[i], CICLO) - 1)
+#define CARD_ciclo PERENNES
+#define NOMBRES_ciclo ciclo_names
+#define CLAVE_bioma(b, i) ((b)->vSeccion[i] % 10)
+#define CARD_bioma N_BIOMAS
+#define NOMBRES_bioma bioma_names
+#define CLAVE_ninguna(b, i) 0          // Column key of the tables with a single column
+#define CARD_ninguna 1
+#define NOMBRES_ninguna NULL
+
+//* Filters of the count tables: the seed with index i of bank b is counted
+#define FILTRO_todas(b, i) true
+#define FILTRO_riesgo_extremo(b, i) (((b)->vCategorias[i] & MASCARA_RIESGO) == RIESGO_EXTREMO << DESPL_RIESGO)
+#define FILTRO_donables(b, i) ((b)->vNumSemillas[i] >= DONACION_MIN_SEMILLAS && (b)->vCaducidad[i] >= DONACION_MIN_CADUCIDAD)
+
+//* Count tables: X(name, row key, column key, filter, title)
+//* Every entry becomes its own kernel (cuenta_<name>) with a fixed-size counter array, so a new
+//* report is one line here; its name is the one used by menu option 8 and the batch command `tabla`.
+#define TABLAS_CONTEO(X) \
+    X(riesgo_ciclo, riesgo, ciclo, todas, "Especies por nivel de riesgo y ciclo de vida") \
+    X(bioma_adaptacion, bioma, adaptacion, todas, "Especies por bioma y adaptacion al ambiente") \
+    X(riesgo_reproduccion, riesgo, reproduccion, todas, "Especies por nivel de riesgo y tipo de reproduccion") \
+    X(peligro_crecimiento, crecimiento, ninguna, riesgo_extremo, "Especies en peligro de extincion por tipo de crecimiento") \
+    X(donables_bioma, bioma, ninguna, donables, "Especies con muestra y caducidad para donar por bioma")
+#define MAX_CELDAS_TABLA (N_BIOMAS * N_BIOMAS) // Largest table (checked at compile time)
+// Related struct: TablaConteo.
+
+//* Phases timed by the instrumentation (see tramo_abre)
+#define FASE_LEE_DATOS 0      // Parse of semillas.txt
+#define FASE_LEE_SNAPSHOT 1   // Map of semillas.bin
+#define FASE_INDICES 2        // Expiration index, bitmaps and summary built after loading
+#define FASE_PELIGRO 3        // Menu option 1
+#define FASE_CADUCIDAD 4      // Menu option 2
+#define FASE_BIOMA 5          // Menu option 3
+#define FASE_DONACION 6       // Menu option 4
+#define FASE_TODOS 7          // Menu option 5
+#define FASE_CONSULTA 8       // Menu option 6
+#define FASE_DELTA 9          // Menu option 7
+#define FASE_VENTANA 10       // Load of one window of the streaming mode
+#define FASE_TABLA 11         // Menu option 8
+#define FASE_CUBO 12          // Batch command cubo
+#define FASE_SITIO 13         // Load and aggregates of one site (--sitios)
+#define FASE_ORDENA 14        // Batch command ordena
+#define FASE_PETICION 15      // One request to the server (seleccionadas: 1 if it came from the cache)
+#define N_FASES 16
+#define N_CONTADORES 2               // Hardware counters of each phase: cycles and instructions
+#define MAX_FICHEROS_METRICAS 32     // Output files counted one by one (later ones are not counted)
+// Related variable: metricas (enabled by SEMILLAS_METRICAS, hardware counters by SEMILLAS_PERF).
 
 //! --------------------- CONSTANTS END --------------------- 
 
 
+//! --------------------- TYPES --------------------- 
+
+//* Seed bank stored as one array per field of semillas.txt (structure of arrays)
+//* The seed with identifier id is stored at index id - 1 of every array.
+//* Categorical fields use the narrowest type that holds them so the scans touch less memory:
+//* the five with at most 5 values share one 16-bit word per seed (see DESPL_*).
+typedef struct {
+    size_t n_semillas;   // Number of slots in use (highest identifier read)
+    size_t n_vivas;      // Number of slots that actually hold a seed
+    size_t capacidad;    // Number of slots allocated in every array
+    size_t id_base;      // Identifier of slot 0 minus 1 (0 except in the windows of the streaming mode)
+
+    uint16_t *vAnyo;            // Year of incorporation into the bank
+    uint16_t *vCaducidad;       // Expiration year of each seed
+    int32_t *vNumSemillas;      // Number of seeds in the sample
+    uint8_t *vSeccion;          // Section number where each seed is stored
+    uint16_t *vCategorias;      // Risk level, growth, reproduction, adaptation and life cycle (SLOT_VACIO if there is no seed)
+
+    void *mapa;          // Snapshot the arrays point into (NULL if the arrays are malloc'd)
+    size_t tam_mapa;     // Size of the mapped snapshot
+} BancoSemillas;
+
+//* Results of the scans of the four reports (filled by recorre_banco)
+typedef struct {
+    //* Seeds in danger of extinction
+    int count_total_riesgo_extremo;
+    int count_by_type[NUM_OF_TYPES_OF_SEEDS];       // Total with riesgo extremo by type (index: type - 1)
+    int count_by_type_total[NUM_OF_TYPES_OF_SEEDS]; // Total by type (index: type - 1)
+
+    //* Seed expiration (between start_year and end_year, filled by indice_cuenta)
+    int count_total_expired_seeds;
+    long long count_total_expired_seed_samples;
+    long long count_total_seed_samples;
+
+    //* Seeds by biome (index: section % 10)
+    int biomas[N_BIOMAS];
+
+    //* Seed donation
+    int contadorDonadas;
+    int contadorNoDonadas;
+} Agregados;
+
+//* Index of the bank by expiration year, built once after loading the data
+//* Seeds are grouped by expiration year (counting sort), so every year range is one
+//* contiguous slice of `indices` and its totals come from the prefix sums in O(1).
+//* Delta files keep the prefix sums up to date but leave `indices` out of date.
+typedef struct {
+    int anyo_min;              // First expiration year in the bank
+    int n_anyos;               // Number of years from anyo_min to the last expiration year
+
+    size_t *semillas_hasta;    // [k]: seeds expiring before anyo_min + k (size n_anyos + 1)
+    long long *muestras_hasta; // [k]: samples of the seeds expiring before anyo_min + k (size n_anyos + 1)
+    uint32_t *indices;         // Seed indexes sorted by expiration year, then by identifier (size n_vivas)
+    bool ordenado;             // `indices` matches the bank (false once a delta file has been applied)
+} IndiceCaducidad;
+
+//* Report file written through a big buffer with write(2), without stdio
+//* With fd == -1 the text stays in memory (the buffer grows) so it can be appended to a file later.
+typedef struct {
+    int fd;            // File descriptor of the report, or -1 for an in-memory writer
+    char *buffer;
+    size_t usado;      // Bytes of the buffer in use
+    size_t capacidad;  // Size of the buffer
+    bool error;        // Some write or allocation failed
+    int metrica;       // Entry of metricas.ficheros, or -1 if the writer is not counted
+    double abierto;    // Time the file was opened (only for counted writers)
+} Escritor;
+
+//* Writes a string literal to a report writer
+#define ESCRIBE(escritor, literal) escritor_texto((escritor), (literal), sizeof(literal) - 1)
+
+//* Header of semillas.bin, followed by the columns of the bank in the order of the struct
+//* The snapshot is only used while the size and modification time, or else the size and
+//* checksum, of semillas.txt still match.
+typedef struct {
+    char magia[4];                        // "SEMB"
+    uint32_t version;                     // SNAPSHOT_VERSION
+    uint64_t n_semillas;                  // Slots of the bank
+    uint64_t n_vivas;                     // Slots with a seed
+    uint64_t tam_origen;                  // Size of semillas.txt when the snapshot was written
+    int64_t seg_origen, nseg_origen;      // Modification time of semillas.txt (seconds, nanoseconds)
+    uint64_t hash_origen;                 // Checksum of semillas.txt when the snapshot was written
+    uint64_t desplazamiento[N_COLUMNAS];  // Offset of each column from the start of the file
+} CabeceraSnapshot;
+
+//* Result of the donation filter as bitmaps (bit i % 64 of word i / 64 is the seed with index i)
+//* The rejection bitmaps only have bits for seeds that meet the minister criteria.
+typedef struct {
+    size_t n_palabras;     // Words of each bitmap
+    uint64_t *ministerio;  // Meets the minister criteria (biennial, without flowers, other adaptation)
+    uint64_t *rechazo[4];  // Meets the criteria but fails UPV restriction 1, 2, 3 or 4
+    uint64_t *donadas;     // Meets the criteria and no restriction
+} FiltroDonacion;
+
+//* Secondary index of the bank: one bitmap per value of each categorical field
+//* Bit i % 64 of word i / 64 is the seed with index i; empty slots are in no bitmap.
+//* Every value holds a good share of the bank, so plain words beat compressed bitmaps here.
+typedef struct {
+    size_t n_palabras;                                // Words of each bitmap
+    uint64_t *vivas;                                  // Slots that hold a seed
+    uint64_t *valor[N_CAMPOS][MAX_VALORES_CAMPO];     // [campo][v - 1]: seeds whose field is v
+} IndiceBitmaps;
+
+//* Ad-hoc query over the categorical fields (see consulta_cuenta)
+//* Bit v - 1 of valores[campo] accepts the value v; a field with no bits accepts any value.
+//* The accepted values of a field are ORed and the fields are ANDed.
+typedef struct {
+    uint16_t valores[N_CAMPOS];
+} Consulta;
+
+//* Ordered listing of expired or donated seeds (batch command ordena)
+typedef struct {
+    bool donadas;                // false: seeds expiring in [start_year, end_year]
+    int start_year, end_year;
+    int orden;                   // ORDEN_*
+    size_t top;                  // Only the first `top` seeds (0 = all of them)
+    const char *ruta;
+} ListadoOrdenado;
+
+//* Responses of the server to the requests already answered for the current data version
+typedef struct {
+    struct {
+        uint64_t hash;             // FNV-1a of `clave`
+        char *clave;               // Request with its words separated by one space (NULL: free entry)
+        char *respuesta;           // Text the command printed, followed by its "FIN" line
+        size_t len;
+        unsigned long long uso;    // Value of `reloj` the last time it was served
+    } entradas[MAX_ENTRADAS_CACHE];
+    unsigned long long reloj;
+    unsigned long long aciertos, fallos;
+} CacheRespuestas;
+
+//* Cube of seed and sample counts over every categorical field and the expiration year
+//* Cell ((((riesgo * 4 + crecimiento) * 2 + reproduccion) * 4 + adaptacion) * 3 + ciclo) * 10 + bioma
+//* (0-based values) of slice k holds the seeds expiring before anyo_min + k, like the prefix sums
+//* of IndiceCaducidad, so a range of years is the difference of two slices. Banks that span more
+//* than MAX_ANYOS_CUBO years keep only the totals (por_anyo is false).
+typedef struct {
+    int anyo_min;         // First expiration year of the slices
+    int n_anyos;          // Slices after the first one, which is always empty
+    bool por_anyo;        // false: slice 1 holds every seed and year ranges cannot be asked
+    int32_t *semillas;    // [k * CUBO_CELDAS + celda]: seeds (size (n_anyos + 1) * CUBO_CELDAS)
+    int64_t *muestras;    // [k * CUBO_CELDAS + celda]: sum of vNumSemillas of those seeds
+} Cubo;
+
+//* Work of one thread in a parallel scan: it runs on the seeds [inicio, fin)
+typedef void (*TareaParalela)(void *contexto, size_t inicio, size_t fin, int hilo);
+
+//* Totals of one instrumented phase, over all its runs
+typedef struct {
+    size_t llamadas;
+    double segundos;
+    unsigned long long filas_recorridas;     // Slots, lines or changes read
+    unsigned long long filas_seleccionadas;  // Seeds that made it into the result
+    uint64_t contadores[N_CONTADORES];       // Cycles and instructions (only with SEMILLAS_PERF)
+} MetricaFase;
+
+//* Totals of one output file, over all the times it was written
+typedef struct {
+    char ruta[64];
+    size_t aperturas;
+    unsigned long long bytes;
+    double segundos;         // From escritor_abre to escritor_cierra
+    double segundos_write;   // Inside write(2)
+} MetricaFichero;
+
+//* Instrumentation of the whole run, dumped at exit to the file in SEMILLAS_METRICAS
+//* Only the main thread opens report files; spans of other threads (the sites of --sitios)
+//* are added under `cerrojo` and without hardware counters, which follow the main thread.
+typedef struct {
+    bool activas;
+    const char *ruta;                     // Dump file (.prom for Prometheus text, JSON otherwise)
+    int fd_contadores[N_CONTADORES];      // perf_event_open descriptors (-1 if not available)
+    pthread_t hilo_principal;             // Thread the counters were opened on
+    pthread_mutex_t cerrojo;              // Guards the totals of the phases
+    MetricaFase fases[N_FASES];
+    MetricaFichero ficheros[MAX_FICHEROS_METRICAS];
+    int n_ficheros;
+} Metricas;
+
+//* Count table generated from TABLAS_CONTEO
+typedef struct {
+    const char *nombre;
+    const char *titulo;
+    int filas, columnas;                   // Values of the row and column keys
+    const char *const *nombres_fila;
+    const char *const *nombres_columna;    // NULL for tables with a single column
+    void (*cuenta)(const BancoSemillas *banco, size_t inicio, size_t fin, int *cuenta); // Adds the seeds [inicio, fin)
+} TablaConteo;
+
+//* Open span of one phase (see tramo_abre)
+typedef struct {
+    int fase;                            // FASE_*, or -1 if the instrumentation is off
+    double inicio;
+    uint64_t contadores[N_CONTADORES];
+} Tramo;
+
+//! --------------------- TYPES END --------------------- 
+
+
+//* Number of worker threads requested for the scans (1 = serial)
+int num_hilos = 1;
+
+//* Instrumentation of the run (off unless SEMILLAS_METRICAS is set)
+Metricas metricas = {.fd_contadores = {-1, -1}, .cerrojo = PTHREAD_MUTEX_INITIALIZER};
+
+//* Names of the instrumented phases in the dump (index: FASE_*)
+const char *fase_names[N_FASES] = {
+    "lee_datos", "lee_snapshot", "indices", "peligro_extincion", "caducidad_semillas",
+    "especies_bioma", "donacion", "todos_los_informes", "consulta_categorias", "aplica_delta",
+    "ventana_streaming", "tabla_conteo", "cubo", "sitio", "ordena_listado", "peticion_servidor"
+};
+
+
+//* Names of the biomes (index: section % 10)
+const char *bioma_names[N_BIOMAS] = {
+    "Tundra",                                  // Biome 1
+    "Bosque caducifolio y bosque mediterráneo", // Biome 2
+    "Pradera",                                 // Biome 3
+    "Chaparral",                               // Biome 4
+    "Desierto",                                // Biome 5
+    "Taiga",                                   // Biome 6
+    "Estepa",                                  // Biome 7
+    "Selva tropical",                          // Biome 8
+    "Sabana",                                  // Biome 9
+    "Biomas acuáticos y arrecifes de coral"    // Biome 10
+};
+
+//* Number of values of each categorical field (index: CAMPO_*)
+const int valores_campo[N_CAMPOS] = {SIN_RIESGO, PLANTA_TREPADORA, SIN_FLORES, OTROS, PERENNES, N_BIOMAS};
+
+//* Names of the values of the keys of the count tables (index: value - 1)
+const char *const riesgo_names[SIN_RIESGO] = {"riesgo extremo", "riesgo alto", "riesgo medio", "riesgo bajo", "sin riesgo"};
+const char *const crecimiento_names[PLANTA_TREPADORA] = {"arboles", "arbustos", "hierbas", "plantas trepadoras"};
+const char *const reproduccion_names[SIN_FLORES] = {"con flores", "sin flores"};
+const char *const adaptacion_names[OTROS] = {"deserticas", "acuaticas", "salinas", "otras"};
+const char *const ciclo_names[PERENNES] = {"anuales", "bienales", "perennes"};
+
+//* Names of the categorical fields, as asked to the user (index: CAMPO_*)
+const char *campo_names[N_CAMPOS] = {
+    "nivel de riesgo", "tipo de crecimiento", "tipo de reproduccion",
+    "tipo de adaptacion", "ciclo de vida", "bioma"
+};
+
+//* Names of the categorical fields in a batch script (index: CAMPO_*)
+const char *campo_claves[N_CAMPOS] = {"riesgo", "crecimiento", "reproduccion", "adaptacion", "ciclo", "bioma"};
+
+//* Names of the sort keys of the ordered listings in a batch script (index: ORDEN_*)
+const char *orden_claves[N_ORDENES] = {"caducidad", "restantes", "muestra", "seccion"};
+
+//* Names of the values of each categorical field (index: CAMPO_*, then value - 1)
+const char *const *valor_names[N_CAMPOS] = {riesgo_names, crecimiento_names, reproduccion_names, adaptacion_names, ciclo_names, bioma_names};
+
+
 //! --------------------- FUNCTIONS DECLARATIONS --------------------- 
 
 //* Prints all the constants defined in the program
 void print_constants_info(void);
 
-//* Reads seed data from the file and fills the arrays
-int lee_datos(int vAnyo[], int vCaducidad[], int vNumSemillas[], int vSeccion[], int vRiesgo[], int vTipoCrecimiento[], int vTipoReproduccion[], int vTipoAdaptacion[], int vTipoCiclo[]);
+//* Creates an empty bank with room for N_SEMILLAS seeds
+int banco_inicializa(BancoSemillas *banco);
+
+//* Makes sure the bank has room for at least n_slots seeds
+int banco_reserva(BancoSemillas *banco, size_t n_slots);
+
+//* Frees all the arrays of the bank
+void banco_libera(BancoSemillas *banco);
+
+//* Reads seed data from a text file in the format of semillas.txt and fills the bank
+int lee_datos(BancoSemillas *banco, const char *ruta);
+
+//* Fills the bank from semillas.bin if it is up to date, otherwise from semillas.txt
+int carga_banco(BancoSemillas *banco);
+
+//* Computes the size and checksum of a file
+int huella_fichero(const char *ruta, uint64_t *tam, uint64_t *hash);
+
+//* Writes the bank to a binary snapshot
+int escribe_snapshot(const BancoSemillas *banco, const char *ruta, const struct stat *origen, uint64_t hash_origen);
+
+//* Maps a binary snapshot into the bank if it matches the text file
+int lee_snapshot(BancoSemillas *banco, const char *ruta, const struct stat *origen, const uint64_t *hash_origen);
 
 void menu(int *memory_of_menu_option);
 
-void peligro_extincion(int vRiesgo[], int vTipoCrecimiento[]);
+//* Builds the expiration year index of the bank
+int indice_construye(IndiceCaducidad *indice, const BancoSemillas *banco);
+
+//* Frees the arrays of the expiration year index
+void indice_libera(IndiceCaducidad *indice);
+
+//* Creates the report file `ruta` and a writer for it
+int escritor_abre(Escritor *escritor, const char *ruta);
+
+//* Creates a writer that keeps its text in memory
+int escritor_en_memoria(Escritor *escritor);
+
+//* Appends len bytes of text to a report writer
+void escritor_texto(Escritor *escritor, const char *texto, size_t len);
+
+//* Appends a number in decimal to a report writer
+void escritor_entero(Escritor *escritor, long long n);
+
+//* Writes the buffered text, closes the file and frees the buffer (-1 if anything failed)
+int escritor_cierra(Escritor *escritor);
+
+//* Fills the expiration aggregates for a range of years in O(1)
+void indice_cuenta(const IndiceCaducidad *indice, int start_year, int end_year, Agregados *ag);
+
+//* Writes the seeds expiring in a range of years, in identifier order
+int escribe_caducadas(const BancoSemillas *banco, const IndiceCaducidad *indice, int start_year, int end_year, Escritor *file);
+
+//* Sets num_hilos from the SEMILLAS_HILOS environment variable or the number of CPUs
+void configura_hilos(void);
+
+//* Number of threads to use for a scan over n seeds
+int hilos_para(size_t n);
+
+//* Turns the instrumentation on if SEMILLAS_METRICAS is set (the dump is written at exit)
+void configura_metricas(void);
+
+//* Starts timing one run of a phase
+void tramo_abre(Tramo *tramo, int fase);
+
+//* Adds the time, counters and rows of a run to the totals of its phase
+void tramo_cierra(const Tramo *tramo, size_t recorridas, size_t seleccionadas);
+
+//* Writes the totals of every phase and output file to the file in SEMILLAS_METRICAS
+void vuelca_metricas(void);
+
+//* Sends the totals of a forked child to its parent, which takes them with recibe_metricas
+void envia_metricas(int fd);
+void recibe_metricas(int fd);
+
+//* Splits the seeds [0, n) in `hilos` parts and runs `tarea` on each one in its own thread
+void ejecuta_en_paralelo(size_t n, int hilos, TareaParalela tarea, void *contexto);
+
+//* Fills the aggregates of the selected reports with one pass over the bank
+void recorre_banco(const BancoSemillas *banco, int informes, FiltroDonacion *filtro, Agregados *ag);
+
+//* Allocates the bitmaps of the donation filter for the bank
+int filtro_crea(FiltroDonacion *filtro, const BancoSemillas *banco);
+
+//* Frees the bitmaps of the donation filter
+void filtro_libera(FiltroDonacion *filtro);
+
+//* Evaluates the donation rules on the seeds [inicio, fin) into the bitmaps
+void filtra_donacion(const BancoSemillas *banco, FiltroDonacion *filtro, size_t inicio, size_t fin);
+
+//* Writes donadas.txt and nodonadas.txt from the donation bitmaps
+void escribe_donacion(const BancoSemillas *banco, const FiltroDonacion *filtro, Escritor *donadas, Escritor *nodonadas);
+
+void peligro_extincion(const Cubo *cubo);
+
+void imprime_peligro_extincion(const Agregados *ag);
+
+void pide_rango_anyos(int *start_year, int *end_year);
+
+int caducidad_semillas(const BancoSemillas *banco, const IndiceCaducidad *indice, int start_year, int end_year, const char *ruta);
+
+int imprime_caducidad(const Agregados *ag, size_t n_vivas);
+
+int especies_bioma(const BancoSemillas *banco, const Cubo *cubo, const char *ruta);
+
+void imprime_bioma(const BancoSemillas *banco, const Agregados *ag, Escritor *file);
+
+void imprime_bioma_mayor(const Agregados *ag, size_t n_vivas);
+
+//* Index of the biome with most seeds
+int bioma_mayor(const Agregados *ag);
+
+//* Writes the seeds of one biome to a report writer
+void escribe_bioma(const BancoSemillas *banco, int bioma, Escritor *file);
+
+void escribe_semillas_bioma(const BancoSemillas *banco, int bioma, Escritor *file);
+
+int donacion(const BancoSemillas *banco, const char *ruta_donadas, const char *ruta_nodonadas, int* contadorDonadas, int* contadorNoDonadas);
+
+void imprime_donacion(int contadorDonadas, int contadorNoDonadas, size_t n_vivas);
+
+//* Writes the expired or donated seeds sorted by a key, or only the first ones
+int ordena_listado(const BancoSemillas *banco, const IndiceCaducidad *indice, const ListadoOrdenado *listado);
+
+//* Runs the four reports with a single pass over the bank
+int todos_los_informes(const BancoSemillas *banco, const IndiceCaducidad *indice, const Cubo *cubo, const Agregados *resumen, int start_year, int end_year);
+
+//* Builds the bitmaps of the categorical fields of the bank
+int bitmaps_construye(IndiceBitmaps *bitmaps, const BancoSemillas *banco);
+
+//* Frees the bitmaps of the categorical fields
+void bitmaps_libera(IndiceBitmaps *bitmaps);
+
+//* Counts the seeds that match a query
+size_t consulta_cuenta(const IndiceBitmaps *bitmaps, const Consulta *consulta);
+
+//* Stores up to max_ids identifiers of the seeds that match a query and returns how many match
+size_t consulta_ids(const IndiceBitmaps *bitmaps, const Consulta *consulta, uint32_t *ids, size_t max_ids);
+
+//* Asks the user for the accepted values of every categorical field
+void pide_consulta(Consulta *consulta);
+
+//* Asks the user for the name of a file
+void pide_fichero(char *ruta, size_t tam);
+
+//* Runs an ad-hoc query over the categorical fields and writes the matching seeds to a file
+int consulta_categorias(const BancoSemillas *banco, const IndiceBitmaps *bitmaps, const Consulta *consulta, const char *ruta);
+
+//* Count table with a given name (NULL if there is none)
+const TablaConteo *busca_tabla(const char *nombre);
+
+//* Asks the user for one of the count tables
+const TablaConteo *pide_tabla(void);
+
+//* Counts the seeds of a count table, with one pass over the bank
+void tabla_cuenta(const BancoSemillas *banco, const TablaConteo *tabla, int cuenta[MAX_CELDAS_TABLA]);
+
+//* Prints a count table of the bank
+void tabla_conteo(const BancoSemillas *banco, const TablaConteo *tabla);
+
+
+//* Builds the cube of counts over the categorical fields and the expiration year
+int cubo_construye(Cubo *cubo, const BancoSemillas *banco);
+
+//* Frees the slices of the cube
+void cubo_libera(Cubo *cubo);
+
+//* Adds up the cells of the cube that match a query, grouped by the values of one field
+int cubo_agrupa(const Cubo *cubo, const Consulta *consulta, int campo, int anyo_inicio, int anyo_fin,
+                long long semillas[MAX_VALORES_CAMPO], long long muestras[MAX_VALORES_CAMPO]);
 
-int caducidad_semillas(int vAnyo[], int vCaducidad[], int vNumSemillas[]);
+//* Fills the risk and biome counts of the reports from the cube
+void cubo_agregados(const Cubo *cubo, Agregados *ag);
 
-int especies_bioma(int vSeccion[], int vAnyo[], int vCaducidad[]);
+//* Prints the seeds and samples of a slice of the cube, optionally by the values of one field
+int cubo_informe(const BancoSemillas *banco, const Cubo *cubo, const Consulta *consulta, int campo, int anyo_inicio, int anyo_fin);
 
-int donacion(int vAnyo[], int vCaducidad[], int vNumSemillas[], int vRiesgo[],
-int vTipoReproduccion[], int vTipoAdaptacion[], int vTipoCiclo[], int* contadorDonadas, int* contadorNoDonadas);
+//* Computes the donation counts of the whole bank
+int resumen_construye(Agregados *resumen, const BancoSemillas *banco);
+
+//* Applies a file of insertions, updates and deletions to the loaded bank and its indexes
+int aplica_delta(BancoSemillas *banco, IndiceCaducidad *indice, IndiceBitmaps *bitmaps, Cubo *cubo, Agregados *resumen, const char *ruta);
+
+//* Writes a synthetic inventory in the format of semillas.txt
+int genera_semillas(const char *ruta, size_t filas, uint64_t semilla);
+
+//* Command line modes: batch script, benchmark over synthetic banks, bounded memory, several sites and inventory generator
+int lote(int argc, char *argv[], BancoSemillas *banco, IndiceCaducidad *indice, IndiceBitmaps *bitmaps, Cubo *cubo, Agregados *resumen);
+
+int servidor(int argc, char *argv[], BancoSemillas *banco, IndiceCaducidad *indice, IndiceBitmaps *bitmaps, Cubo *cubo, Agregados *resumen);
+
+int benchmark(int argc, char *argv[]);
+
+int streaming(int argc, char *argv[]);
+
+int sitios(int argc, char *argv[]);
+
+int genera(int argc, char *argv[]);
 
 
 //! --------------------- FUNCTIONS DECLARATIONS END --------------------- 
 
-int main() {
+int main(int argc, char *argv[]) {
 
     //! --------------------- GLOBAL VARS ---------------------
 
-    //* Arrays to store information about each seed (from semillas.txt)
-    int vAnyo[N_SEMILLAS] = {0};           // Year of incorporation into the bank
-    int vCaducidad[N_SEMILLAS] = {0};      // Expiration year of each seed
-    int vNumSemillas[N_SEMILLAS] = {0};    // Number of seeds in the sample
-    int vSeccion[N_SEMILLAS] = {0};        // Section number where each seed is stored
-    int vRiesgo[N_SEMILLAS] = {0};         // Extinction risk level of each seed
-    int vTipoCrecimiento[N_SEMILLAS] = {0}; // Growth type of each seed
-    int vTipoReproduccion[N_SEMILLAS] = {0}; // Reproduction type of each seed
-    int vTipoAdaptacion[N_SEMILLAS] = {0};  // Environmental adaptation type of each seed
-    int vTipoCiclo[N_SEMILLAS] = {0};       // Life cycle type of each seed
+    //* Bank with the information about each seed (from semillas.txt)
+    BancoSemillas banco;
+
+    //* Seeds of the bank by expiration year
+    IndiceCaducidad indice;
+
+    //* Seeds of the bank by value of each categorical field
+    IndiceBitmaps bitmaps;
+
+    //* Seeds and samples by every categorical field and expiration year (kept up to date by delta files)
+    Cubo cubo;
+
+    //* Donation counts of the whole bank (kept up to date by delta files)
+    Agregados resumen;
 
     //* Counters for donated and non-donated seeds
     int contadorDonadas, contadorNoDonadas = 0;
 
     //! --------------------- GLOBAL VARS END ---------------------
 
-    // Call the function to read data from the file
-    // Returns an error if file cannot be opened
-    if(lee_datos(vAnyo, vCaducidad, vNumSemillas, vSeccion, vRiesgo,
-                  vTipoCrecimiento, vTipoReproduccion, vTipoAdaptacion,
-                  vTipoCiclo) == -1) {
+    configura_hilos();
+    configura_metricas();
+
+    // Non-interactive modes
+    if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) return benchmark(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--genera") == 0) return genera(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--streaming") == 0) return streaming(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--sitios") == 0) return sitios(argc - 2, argv + 2);
+
+    if(banco_inicializa(&banco) == -1) {
+        fprintf(stderr, "Error: No hay memoria suficiente para el banco de semillas\n");
+        return 0;
+    }
+
+    // Call the function to read data from the file (or its binary snapshot)
+    // Returns an error if file cannot be opened or has invalid data
+    int resultado_lectura = carga_banco(&banco);
+
+    if(resultado_lectura == -1) {
         fprintf(stderr, "Error: No se pudo abrir el archivo semillas.txt\n");
+        banco_libera(&banco);
+        return 0;
+    } else if(resultado_lectura == -2) {
+        fprintf(stderr, "Error: El archivo semillas.txt contiene datos fuera de rango\n");
+        banco_libera(&banco);
+        return 0;
+    }
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_INDICES);
+
+    if(indice_construye(&indice, &banco) == -1) {
+        fprintf(stderr, "Error: No hay memoria suficiente para el banco de semillas\n");
+        banco_libera(&banco);
+        return 0;
+    }
+
+    if(bitmaps_construye(&bitmaps, &banco) == -1) {
+        fprintf(stderr, "Error: No hay memoria suficiente para el banco de semillas\n");
+        indice_libera(&indice);
+        banco_libera(&banco);
+        return 0;
+    }
+
+    if(cubo_construye(&cubo, &banco) == -1) {
+        fprintf(stderr, "Error: No hay memoria suficiente para el banco de semillas\n");
+        bitmaps_libera(&bitmaps);
+        indice_libera(&indice);
+        banco_libera(&banco);
+        return 0;
+    }
+
+    if(resumen_construye(&resumen, &banco) == -1) {
+        fprintf(stderr, "Error: No hay memoria suficiente para el banco de semillas\n");
+        cubo_libera(&cubo);
+        bitmaps_libera(&bitmaps);
+        indice_libera(&indice);
+        banco_libera(&banco);
         return 0;
     }
 
+    tramo_cierra(&tramo, banco.n_semillas, banco.n_vivas);
+
+    // Batch mode: every line of the script runs against the data loaded once
+    if (argc > 1 && strcmp(argv[1], "--lote") == 0) {
+        int resultado = lote(argc - 2, argv + 2, &banco, &indice, &bitmaps, &cubo, &resumen);
+
+        cubo_libera(&cubo);
+        bitmaps_libera(&bitmaps);
+        indice_libera(&indice);
+        banco_libera(&banco);
+        return resultado;
+    }
+
+    // Server mode: the same commands from clients of a Unix socket, with the data kept loaded
+    if (argc > 1 && strcmp(argv[1], "--servidor") == 0) {
+        int resultado = servidor(argc - 2, argv + 2, &banco, &indice, &bitmaps, &cubo, &resumen);
+
+        cubo_libera(&cubo);
+        bitmaps_libera(&bitmaps);
+        indice_libera(&indice);
+        banco_libera(&banco);
+        return resultado;
+    }
+
     int menu_option;
 
+    int start_year, end_year;   // Range of expiration years asked for options 2 and 5
+    Consulta consulta;          // Values asked for option 6
+    char ruta_delta[256];       // Delta file asked for option 7
+    const TablaConteo *tabla;   // Count table asked for option 8
+
     do {
 
         menu(&menu_option); // Display menu and get user's choice
@@ -171,12 +912,13 @@ int main() {
 
             case 1:
                 // Function to process seeds in danger of extinction
-                peligro_extincion(vRiesgo, vTipoCrecimiento);
+                peligro_extincion(&cubo);
                 break;
 
             case 2:
                 // Function to calculate seed expiration
-                if(caducidad_semillas(vAnyo, vCaducidad, vNumSemillas) == -1) {
+                pide_rango_anyos(&start_year, &end_year);
+                if(caducidad_semillas(&banco, &indice, start_year, end_year, "caducadas.txt") == -1) {
                     fprintf(stderr, "Error: No se pudo crear el archivo caducadas.txt");
                     return 1;
                 };
@@ -184,7 +926,7 @@ int main() {
 
             case 3:
                 // Function to find the biome with the highest percentage of species
-                if(especies_bioma(vSeccion, vAnyo, vCaducidad) == -1){
+                if(especies_bioma(&banco, &cubo, "bioma.txt") == -1){
                     fprintf(stderr, "Error: No se pudo crear el archivo bioma.txt");
                     return 1;
                 };
@@ -192,25 +934,57 @@ int main() {
 
             case 4:
                 // Function to process seed donation
-                if(donacion(vAnyo, vCaducidad, vNumSemillas, vRiesgo,
-                        vTipoReproduccion, vTipoAdaptacion, vTipoCiclo, &contadorDonadas, &contadorNoDonadas) == -1) {
+                if(donacion(&banco, "donadas.txt", "nodonadas.txt", &contadorDonadas, &contadorNoDonadas) == -1) {
                             fprintf(stderr, "Error: No se pudo crear los archivos");
                             return 1;
                         } else {
-                            int total = contadorDonadas + contadorNoDonadas;
-                            printf("Semillas que cumplen las condiciones %d (%.1f%%):\n", total, total / (float) N_SEMILLAS * 100);
-                            printf("    Donadas %d (%.1f%%)\n", contadorDonadas, contadorDonadas / (float) N_SEMILLAS * 100);
-                            printf("    No donadas %d (%.1f%%)\n", contadorNoDonadas, contadorNoDonadas / (float) N_SEMILLAS * 100);
+                            imprime_donacion(contadorDonadas, contadorNoDonadas, banco.n_vivas);
                         }
                 break;
 
+            case 5:
+                // Function to run every report with a single pass over the bank
+                pide_rango_anyos(&start_year, &end_year);
+                if(todos_los_informes(&banco, &indice, &cubo, &resumen, start_year, end_year) == -1) {
+                    fprintf(stderr, "Error: No se pudo crear los archivos");
+                    return 1;
+                }
+                break;
+
+            case 6:
+                // Function to count and list the seeds of an ad-hoc slice of the categorical fields
+                pide_consulta(&consulta);
+                if(consulta_categorias(&banco, &bitmaps, &consulta, "consulta.txt") == -1) {
+                    fprintf(stderr, "Error: No se pudo crear el archivo consulta.txt");
+                    return 1;
+                }
+                break;
+
+            case 7:
+                // Function to apply the insertions, updates and deletions of a delta file
+                pide_fichero(ruta_delta, sizeof(ruta_delta));
+                if(aplica_delta(&banco, &indice, &bitmaps, &cubo, &resumen, ruta_delta) == -1) {
+                    fprintf(stderr, "Error: No se pudo aplicar el archivo %s\n", ruta_delta);
+                }
+                break;
+
+            case 8:
+                // Function to count the seeds by the keys of one of the tables of TABLAS_CONTEO
+                tabla = pide_tabla();
+                if (tabla != NULL) tabla_conteo(&banco, tabla);
+                break;
+
             case 0:
                 printf("Finalizando el programa...\n");
+                cubo_libera(&cubo);
+                bitmaps_libera(&bitmaps);
+                indice_libera(&indice);
+                banco_libera(&banco);
                 return 1;
                 break;
 
             default:
-                printf("Opción inválida. Por favor, elija una opción entre 0 y 4.\n");
+                printf("Opción inválida. Por favor, elija una opción entre 0 y 8.\n");
                 break;
 
         }
@@ -219,310 +993,4955 @@ int main() {
 
     // print_constants_info(); //print constant values
 
+    cubo_libera(&cubo);
+    bitmaps_libera(&bitmaps);
+    indice_libera(&indice);
+    banco_libera(&banco);
     return 0;
 }
 
 //! --------------------- FUNCTIONS --------------------- 
 
-//* Function to process seeds in danger of extinction
-void peligro_extincion(int vRiesgo[], int vTipoCrecimiento[]) {
+//* Function to set the number of worker threads
+//* SEMILLAS_HILOS=n forces n threads, otherwise there is one per CPU
+void configura_hilos(void) {
+    const char *valor = getenv("SEMILLAS_HILOS");
+
+    if (valor != NULL && atoi(valor) > 0) {
+        num_hilos = atoi(valor);
+    } else {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_hilos = cpus > 0 ? (int) cpus : 1;
+    }
 
-    int count_total_riesgo_extremo = 0;
+    if (num_hilos > MAX_HILOS) num_hilos = MAX_HILOS;
+}
 
-    //Total with riesgo extremo by type
-    int count_by_type[NUM_OF_TYPES_OF_SEEDS] = {0}; // Index 0: ARBOL - 1, 1: ARBUSTO - 1, 2: HIERBA - 1, 3: PLANTA_TREPADORA - 1
-    //Total by type
-    int count_by_type_total[NUM_OF_TYPES_OF_SEEDS] = {0}; // Index 0: ARBOL - 1, 1: ARBUSTO - 1, 2: HIERBA - 1, 3: PLANTA_TREPADORA - 1
-    float percentages[NUM_OF_TYPES_OF_SEEDS] = {0}; // Index 0: ARBOL - 1, 1: ARBUSTO - 1, 2: HIERBA - 1, 3: PLANTA_TREPADORA - 1
+//* Function to choose how many threads scan n seeds (small banks stay serial)
+int hilos_para(size_t n) {
+    size_t hilos = n / MIN_SEMILLAS_POR_HILO;
 
-    const char *type_names[] = {"arboles", "arbustos", "hierbas", "plantas trepadoras"};
+    if (hilos > (size_t) num_hilos) hilos = num_hilos;
+    return hilos > 0 ? (int) hilos : 1;
+}
 
-    for (int i = 0; i < N_SEMILLAS; i++) {
+//* Part of a parallel scan, passed to the thread that runs it
+typedef struct {
+    TareaParalela tarea;
+    void *contexto;
+    size_t inicio, fin;
+    int hilo;
+} ParteParalela;
+
+static void *ejecuta_parte(void *arg) {
+    ParteParalela *parte = arg;
+    parte->tarea(parte->contexto, parte->inicio, parte->fin, parte->hilo);
+    return NULL;
+}
 
-        if (vRiesgo[i] == RIESGO_EXTREMO) { 
-            count_total_riesgo_extremo++;
+//* Function to run a task over the seeds [0, n) split in `hilos` contiguous parts
+//* Parts start at multiples of 64 seeds, so tasks that fill bitmaps never share a word.
+//* The calling thread runs part 0; if a thread cannot be created its part also runs here.
+void ejecuta_en_paralelo(size_t n, int hilos, TareaParalela tarea, void *contexto) {
+    ParteParalela partes[MAX_HILOS];
+    pthread_t ids[MAX_HILOS];
+    bool creado[MAX_HILOS] = {false};
 
-            count_by_type[vTipoCrecimiento[i] - 1]++;
-        }
+    size_t tam_parte = ((n + hilos - 1) / hilos + 63) / 64 * 64;
 
-        count_by_type_total[vTipoCrecimiento[i] - 1]++;
+    for (int h = 0; h < hilos; h++) {
+        size_t inicio = h * tam_parte < n ? h * tam_parte : n;
+        size_t fin = inicio + tam_parte < n ? inicio + tam_parte : n;
+        partes[h] = (ParteParalela) {tarea, contexto, inicio, fin, h};
 
+        if (h > 0) creado[h] = pthread_create(&ids[h], NULL, ejecuta_parte, &partes[h]) == 0;
     }
 
-    //prevents division by 0
-    if(count_total_riesgo_extremo == 0) {
-        printf("Hay 0 especies en peligro de extincion");
-        return;
-    } 
+    ejecuta_parte(&partes[0]);
+
+    for (int h = 1; h < hilos; h++) {
+        if (creado[h]) pthread_join(ids[h], NULL);
+        else ejecuta_parte(&partes[h]);
+    }
+}
 
+//* Seconds of the monotonic clock
+static double reloj_segundos(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
 
-    for (int i = 0; i < NUM_OF_TYPES_OF_SEEDS; i++) {
-        percentages[i] = (count_by_type[i] / (float) count_by_type_total[i] * 100);
+//* Opens one hardware counter of this process and the threads it creates (-1 if not available)
+static int abre_contador(uint64_t evento) {
+#if defined(__linux__)
+    struct perf_event_attr atributos;
+    memset(&atributos, 0, sizeof(atributos));
+
+    atributos.type = PERF_TYPE_HARDWARE;
+    atributos.size = sizeof(atributos);
+    atributos.config = evento;
+    atributos.inherit = 1;          // The scan threads are created after the counter
+    atributos.exclude_kernel = 1;   // Allowed without privileges on most systems
+    atributos.exclude_hv = 1;
+
+    return (int) syscall(SYS_perf_event_open, &atributos, 0, -1, -1, 0);
+#else
+    (void) evento;
+    return -1;
+#endif
+}
+
+//* Opens the cycle and instruction counters on the calling thread
+//* A forked child calls it again: the counters it inherits only add its work when it exits.
+static void abre_contadores(void) {
+#if defined(__linux__)
+    uint64_t eventos[N_CONTADORES] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS};
+#else
+    uint64_t eventos[N_CONTADORES] = {0};
+#endif
+    for (int c = 0; c < N_CONTADORES; c++) {
+        if (metricas.fd_contadores[c] != -1) close(metricas.fd_contadores[c]);
+        metricas.fd_contadores[c] = abre_contador(eventos[c]);
     }
+    metricas.hilo_principal = pthread_self();
+}
 
-    //Find type with highest risk:
-    int index_of_highest_risk = 0;
+//* Function to turn the instrumentation on
+//* SEMILLAS_METRICAS=ruta times every phase and output file and writes the totals to ruta at exit;
+//* SEMILLAS_PERF=1 also counts cycles and instructions with perf_event_open
+void configura_metricas(void) {
+    const char *ruta = getenv("SEMILLAS_METRICAS");
+    if (ruta == NULL || ruta[0] == '\0') return;
 
-    for (int i = 0; i < NUM_OF_TYPES_OF_SEEDS; i++) {
-        if(percentages[i] > percentages[index_of_highest_risk]) index_of_highest_risk = i;
+    metricas.activas = true;
+    metricas.ruta = ruta;
+    metricas.hilo_principal = pthread_self();
+
+    const char *perf = getenv("SEMILLAS_PERF");
+    if (perf != NULL && atoi(perf) > 0) {
+        abre_contadores();
+
+        if (metricas.fd_contadores[0] == -1 || metricas.fd_contadores[1] == -1) {
+            fprintf(stderr, "Aviso: No se pudieron abrir los contadores hardware; solo se mide el tiempo\n");
+        }
     }
 
+    atexit(vuelca_metricas);
+}
 
-    // Print the total number of endangered species
-    printf("Hay %d especies en peligro de extincion:\n", count_total_riesgo_extremo);
+//* Reads the hardware counters (0 for the ones not available, and on threads other than the main one)
+static void lee_contadores(uint64_t contadores[N_CONTADORES]) {
+    bool principal = pthread_equal(pthread_self(), metricas.hilo_principal);
 
-    // Print the breakdown of endangered species by plant type
-    for (int i = 0; i < NUM_OF_TYPES_OF_SEEDS; i ++) {
-            printf("    %d %s (%.1f%% del total de %s)\n", count_by_type[i], type_names[i], percentages[i], type_names[i]);
+    for (int c = 0; c < N_CONTADORES; c++) {
+        contadores[c] = 0;
+        if (principal && metricas.fd_contadores[c] != -1 &&
+            read(metricas.fd_contadores[c], &contadores[c], sizeof(uint64_t)) != (ssize_t) sizeof(uint64_t)) {
+            contadores[c] = 0;
+        }
     }
+}
 
-    // Print the plant type with the highest percentage of endangered species
-    printf("\nEl mayor porcentaje de especies en peligro de extincion corresponde a %s (%.1f%% del total de %s)\n", type_names[index_of_highest_risk], percentages[index_of_highest_risk], type_names[index_of_highest_risk]);
+//* Function to start timing one run of a phase (does nothing if the instrumentation is off)
+void tramo_abre(Tramo *tramo, int fase) {
+    tramo->fase = metricas.activas ? fase : -1;
+    if (tramo->fase == -1) return;
 
+    lee_contadores(tramo->contadores);
+    tramo->inicio = reloj_segundos();
 }
 
-//* Function to calculate seed expiration
-int caducidad_semillas(int vAnyo[], int vCaducidad[], int vNumSemillas[]) {
+//* Function to add a finished run to the totals of its phase
+//* recorridas: slots, lines or changes the run read; seleccionadas: seeds in its result
+void tramo_cierra(const Tramo *tramo, size_t recorridas, size_t seleccionadas) {
+    if (tramo->fase == -1) return;
 
-    FILE *file = fopen("caducadas.txt", "w");
+    double fin = reloj_segundos();
+    uint64_t contadores[N_CONTADORES];
+    lee_contadores(contadores);
 
-    if (file == NULL) {
-        return -1; // Return error code if the file couldn't be created
+    pthread_mutex_lock(&metricas.cerrojo);
+
+    MetricaFase *fase = &metricas.fases[tramo->fase];
+    fase->llamadas++;
+    fase->segundos += fin - tramo->inicio;
+    fase->filas_recorridas += recorridas;
+    fase->filas_seleccionadas += seleccionadas;
+    for (int c = 0; c < N_CONTADORES; c++) fase->contadores[c] += contadores[c] - tramo->contadores[c];
+
+    pthread_mutex_unlock(&metricas.cerrojo);
+}
+
+//* Entry of an output file in the instrumentation (-1 if it is off or the table is full)
+static int metrica_fichero(const char *ruta) {
+    if (!metricas.activas) return -1;
+
+    for (int f = 0; f < metricas.n_ficheros; f++) {
+        if (strncmp(metricas.ficheros[f].ruta, ruta, sizeof(metricas.ficheros[f].ruta) - 1) == 0) return f;
     }
 
-    int start_year, end_year;
+    if (metricas.n_ficheros == MAX_FICHEROS_METRICAS) return -1;
 
-    int count_total_expired_seeds = 0; // Counter for expired seeds
+    MetricaFichero *fichero = &metricas.ficheros[metricas.n_ficheros];
+    snprintf(fichero->ruta, sizeof(fichero->ruta), "%s", ruta);
+    return metricas.n_ficheros++;
+}
 
-    int count_total_seed_samples = 0; // Counter for total seed samples
-    int count_total_expired_seed_samples = 0; // Counter for expired seed samples
+//* Writes a file name as a quoted JSON string or Prometheus label value (both escape the same way)
+static void escribe_cadena_metricas(FILE *salida, const char *texto) {
+    fputc('"', salida);
+    for (const char *c = texto; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') fprintf(salida, "\\%c", *c);
+        else if (*c == '\n') fputs("\\n", salida);
+        else if ((unsigned char) *c >= ' ') fputc(*c, salida);
+    }
+    fputc('"', salida);
+}
 
-    // Get the start year (with input validation)
-    do {
-        printf("Introduce el anyo de inicio: ");
-        if (scanf("%d", &start_year) != 1 || start_year < 2020) {
-            printf("Entrada invalida. El anyo de inicio debe ser un numero entero mayor o igual a 2020.\n");
-            while (getchar() != '\n'); // Clear invalid input from the buffer
-            start_year = -1; 
+//* Prometheus text format: one counter per phase or file and value
+static void vuelca_prometheus(FILE *salida, bool contadores) {
+    static const char *nombres[] = {
+        "semillas_fase_llamadas_total", "semillas_fase_segundos_total",
+        "semillas_fase_filas_recorridas_total", "semillas_fase_filas_seleccionadas_total",
+        "semillas_fase_ciclos_total", "semillas_fase_instrucciones_total"
+    };
+    int n_valores = contadores ? 6 : 4;
+
+    for (int v = 0; v < n_valores; v++) {
+        fprintf(salida, "# TYPE %s counter\n", nombres[v]);
+
+        for (int f = 0; f < N_FASES; f++) {
+            const MetricaFase *fase = &metricas.fases[f];
+            if (fase->llamadas == 0) continue;
+
+            fprintf(salida, "%s{fase=\"%s\"} ", nombres[v], fase_names[f]);
+            switch (v) {
+                case 0: fprintf(salida, "%zu\n", fase->llamadas); break;
+                case 1: fprintf(salida, "%.9f\n", fase->segundos); break;
+                case 2: fprintf(salida, "%llu\n", fase->filas_recorridas); break;
+                case 3: fprintf(salida, "%llu\n", fase->filas_seleccionadas); break;
+                default: fprintf(salida, "%llu\n", (unsigned long long) fase->contadores[v - 4]); break;
+            }
         }
-    } while (start_year < 2020);
+    }
 
-    // Get the end year (with input validation)
-    do {
-        printf("Introduce el anyo de finalizacion: ");
-        if (scanf("%d", &end_year) != 1 || end_year < start_year) {
-            printf("Entrada invalida. El anyo de finalizacion debe ser un numero entero mayor o igual al anyo de inicio.\n");
-            while (getchar() != '\n'); // Clear invalid input from the buffer
-            end_year = -1;
-        }
-    } while (end_year < start_year);
+    static const char *nombres_fichero[] = {
+        "semillas_fichero_aperturas_total", "semillas_fichero_bytes_total",
+        "semillas_fichero_segundos_total", "semillas_fichero_write_segundos_total"
+    };
 
-    // Checks all seeds and filter based on expiration date
-    for (int i = 0; i < N_SEMILLAS; i++) {
-        // Check if the seed's expiration date falls within the range
-        if (vCaducidad[i] >= start_year && vCaducidad[i] <= end_year) {
-            // Write seed details to the file
-            fprintf(file, "Semilla %d: anyo de entrada %d anyo de caducidad %d (muestra %d)\n",
-                    i + 1, vAnyo[i], vCaducidad[i], vNumSemillas[i]);
+    for (int v = 0; v < 4; v++) {
+        fprintf(salida, "# TYPE %s counter\n", nombres_fichero[v]);
+
+        for (int f = 0; f < metricas.n_ficheros; f++) {
+            const MetricaFichero *fichero = &metricas.ficheros[f];
 
-            // Increment expired seeds and their sample count
-            count_total_expired_seeds++;
-            count_total_expired_seed_samples += vNumSemillas[i];
+            fprintf(salida, "%s{fichero=", nombres_fichero[v]);
+            escribe_cadena_metricas(salida, fichero->ruta);
+            switch (v) {
+                case 0: fprintf(salida, "} %zu\n", fichero->aperturas); break;
+                case 1: fprintf(salida, "} %llu\n", fichero->bytes); break;
+                case 2: fprintf(salida, "} %.9f\n", fichero->segundos); break;
+                default: fprintf(salida, "} %.9f\n", fichero->segundos_write); break;
+            }
         }
+    }
+}
 
-        // Count total samples across all seeds
-        count_total_seed_samples += vNumSemillas[i];
+//* JSON: {"hilos": n, "fases": [...], "ficheros": [...]}
+static void vuelca_json(FILE *salida, bool contadores) {
+    fprintf(salida, "{\n  \"hilos\": %d,\n  \"fases\": [", num_hilos);
+
+    bool primero = true;
+    for (int f = 0; f < N_FASES; f++) {
+        const MetricaFase *fase = &metricas.fases[f];
+        if (fase->llamadas == 0) continue;
+
+        fprintf(salida, "%s\n    {\"fase\": \"%s\", \"llamadas\": %zu, \"segundos\": %.9f, "
+                "\"filas_recorridas\": %llu, \"filas_seleccionadas\": %llu",
+                primero ? "" : ",", fase_names[f], fase->llamadas, fase->segundos,
+                fase->filas_recorridas, fase->filas_seleccionadas);
+        if (contadores) {
+            fprintf(salida, ", \"ciclos\": %llu, \"instrucciones\": %llu",
+                    (unsigned long long) fase->contadores[0], (unsigned long long) fase->contadores[1]);
+        }
+        fputc('}', salida);
+        primero = false;
     }
 
-    // Prevent division by zero (just in case)
-    if (count_total_seed_samples == 0) {
-        printf("Error: No hay muestras de semillas en el banco.\n");
-        fclose(file);
-        return -1;
+    fprintf(salida, "\n  ],\n  \"ficheros\": [");
+
+    for (int f = 0; f < metricas.n_ficheros; f++) {
+        const MetricaFichero *fichero = &metricas.ficheros[f];
+
+        fprintf(salida, "%s\n    {\"fichero\": ", f == 0 ? "" : ",");
+        escribe_cadena_metricas(salida, fichero->ruta);
+        fprintf(salida, ", \"aperturas\": %zu, \"bytes\": %llu, \"segundos\": %.9f, \"segundos_write\": %.9f}",
+                fichero->aperturas, fichero->bytes, fichero->segundos, fichero->segundos_write);
     }
 
-    // Calculate percentages
-    float percentage_of_total_expired_seeds = count_total_expired_seeds / (float) N_SEMILLAS * 100;
-    float percentage_of_total_expired_seed_samples = count_total_expired_seed_samples / (float) count_total_seed_samples * 100;
+    fprintf(salida, "\n  ]\n}\n");
+}
 
-    // Display results to the user
-    printf("Cantidad de muestras de semillas caducadas: %d (%.1f%% del total)\n",
-           count_total_expired_seed_samples, percentage_of_total_expired_seed_samples);
-    printf("Numero de semillas caducadas: %d (%.1f%% del total)\n",
-           count_total_expired_seeds, percentage_of_total_expired_seeds);
+//* Function to write the instrumentation to the file in SEMILLAS_METRICAS (registered with atexit)
+void vuelca_metricas(void) {
+    if (!metricas.activas) return;
 
-    fclose(file);
-    return 0;
+    FILE *salida = fopen(metricas.ruta, "w");
+    if (salida == NULL) {
+        fprintf(stderr, "Aviso: No se pudo escribir el archivo %s\n", metricas.ruta);
+        return;
+    }
+
+    bool contadores = metricas.fd_contadores[0] != -1 && metricas.fd_contadores[1] != -1;
+
+    size_t largo = strlen(metricas.ruta);
+    if (largo >= 5 && strcmp(metricas.ruta + largo - 5, ".prom") == 0) vuelca_prometheus(salida, contadores);
+    else vuelca_json(salida, contadores);
+
+    if (fclose(salida) != 0) fprintf(stderr, "Aviso: No se pudo escribir el archivo %s\n", metricas.ruta);
 }
 
-//* Function to find the biome with the highest percentage of species
-int especies_bioma(int vSeccion[], int vAnyo[], int vCaducidad[]) {
-
-    FILE *file = fopen("bioma.txt", "w");
-
-    if(file == NULL) return -1;
-
-    int biomas[10] = {0};
-    float percentage_biomas[10] = {0};
-
-    const char *bioma_names[] = {
-        "Tundra",                                  // Biome 1
-        "Bosque caducifolio y bosque mediterráneo", // Biome 2
-        "Pradera",                                 // Biome 3
-        "Chaparral",                               // Biome 4
-        "Desierto",                                // Biome 5
-        "Taiga",                                   // Biome 6
-        "Estepa",                                  // Biome 7
-        "Selva tropical",                          // Biome 8
-        "Sabana",                                  // Biome 9
-        "Biomas acuáticos y arrecifes de coral"    // Biome 10
-    };
+//* Totals of the instrumentation as they travel from a forked child to its parent
+typedef struct {
+    MetricaFase fases[N_FASES];
+    MetricaFichero ficheros[MAX_FICHEROS_METRICAS];
+    int n_ficheros;
+} TotalesMetricas;
 
-    for (int i = 0; i < N_SEMILLAS; i ++) {
-        int biome_index = vSeccion[i] % 10;
-        biomas[biome_index]++;
+//* Function to send the totals of the instrumentation down a pipe (from a forked child)
+void envia_metricas(int fd) {
+    if (!metricas.activas) return;
+
+    TotalesMetricas totales;
+    memcpy(totales.fases, metricas.fases, sizeof(totales.fases));
+    memcpy(totales.ficheros, metricas.ficheros, sizeof(totales.ficheros));
+    totales.n_ficheros = metricas.n_ficheros;
+
+    const char *p = (const char *) &totales;
+    size_t pendientes = sizeof(totales);
+
+    while (pendientes > 0) {
+        ssize_t escritos = write(fd, p, pendientes);
+        if (escritos == -1 && errno == EINTR) continue;
+        if (escritos <= 0) return;
+
+        p += escritos;
+        pendientes -= escritos;
     }
+}
 
-    int index_of_highest_biome = 0;
+//* Function to take the totals sent by a forked child with envia_metricas
+//* The child started from a copy of these totals, so its own already include them.
+//* Nothing changes if the child died before sending them whole.
+void recibe_metricas(int fd) {
+    if (!metricas.activas) return;
 
-    for (int i = 0; i < (10); i++) {
-        percentage_biomas[i] = (biomas[i] / (float) N_SEMILLAS) * 100;
+    TotalesMetricas totales;
+    char *p = (char *) &totales;
+    size_t pendientes = sizeof(totales);
 
-        // printf("\nBioma %d: %.2f\n", i + 1, percentage_biomas[i]);
+    while (pendientes > 0) {
+        ssize_t leidos = read(fd, p, pendientes);
+        if (leidos == -1 && errno == EINTR) continue;
+        if (leidos <= 0) return;
 
-        if (biomas[i] > biomas[index_of_highest_biome]) {
-            index_of_highest_biome = i;
-        }
+        p += leidos;
+        pendientes -= leidos;
     }
 
+    memcpy(metricas.fases, totales.fases, sizeof(totales.fases));
+    memcpy(metricas.ficheros, totales.ficheros, sizeof(totales.ficheros));
+    metricas.n_ficheros = totales.n_ficheros;
+}
 
-    fprintf(file, "Semillas del bioma %s \n\n", bioma_names[index_of_highest_biome]);
-    for (int i = 0; i < N_SEMILLAS; i ++) {
+//* Seeds left in a sample after donating DONACION_PORCENTAJE percent of it (rounded up)
+static inline long long semillas_tras_donar(int32_t num_semillas) {
+    return num_semillas - (long long) num_semillas * DONACION_PORCENTAJE / 100;
+}
 
-        int biome_index = vSeccion[i] % 10;
+//* Adds the aggregates of one part of the bank to the total
+static void suma_agregados(Agregados *total, const Agregados *parte) {
+    total->count_total_riesgo_extremo += parte->count_total_riesgo_extremo;
 
-        if(biome_index == index_of_highest_biome) {
-            fprintf(file, "Semilla %d: entrada %d caducidad %d\n", i + 1, vAnyo[i], vCaducidad[i]);
-        }
+    for (int t = 0; t < NUM_OF_TYPES_OF_SEEDS; t++) {
+        total->count_by_type[t] += parte->count_by_type[t];
+        total->count_by_type_total[t] += parte->count_by_type_total[t];
     }
-    
-    printf("El bioma con mayor porcentaje de semillas en el banco es %d: %s (semillas %d, %.1f%% del total)\n", index_of_highest_biome + 1 ,bioma_names[index_of_highest_biome], biomas[index_of_highest_biome], percentage_biomas[index_of_highest_biome]);
 
-    return 0;
+    for (int b = 0; b < N_BIOMAS; b++) total->biomas[b] += parte->biomas[b];
+
+    total->contadorDonadas += parte->contadorDonadas;
+    total->contadorNoDonadas += parte->contadorNoDonadas;
 }
 
-//* Function to process seed donation
-int donacion(int vAnyo[], int vCaducidad[], int vNumSemillas[], int vRiesgo[],
-             int vTipoReproduccion[], int vTipoAdaptacion[], int vTipoCiclo[], int* contadorDonadas, int* contadorNoDonadas) {
+//* Scans the seeds [inicio, fin) adding their aggregates to `ag`
+static void recorre_rango(const BancoSemillas *banco, int informes, size_t inicio, size_t fin, Agregados *ag) {
 
-    FILE *_donadas = fopen("donadas.txt", "w");
-    FILE *_nodonadas = fopen("nodonadas.txt", "w");
+    bool peligro = informes & INFORME_PELIGRO;
+    bool bioma = informes & INFORME_BIOMA;
 
-    if(_donadas == NULL || _nodonadas == NULL) return -1;
+    const uint8_t *vSeccion = banco->vSeccion;
+    const uint16_t *vCategorias = banco->vCategorias;
 
-    *contadorDonadas = 0;
-    *contadorNoDonadas = 0;
+    for (size_t i = inicio; i < fin; i++) {
 
-    for (int i = 0; i < N_SEMILLAS; i++) {
+        uint16_t categorias = vCategorias[i];
 
-        int seed_id = i + 1;
+        if (categorias == SLOT_VACIO) continue; // No seed with this identifier
 
-        bool can_donate = true; //change it to false if does not meet at least one of UPV restrictions
+        if (peligro) {
+            int tipo = CATEGORIA(categorias, CRECIMIENTO) - 1;
 
-        //check if seed meets donation creterias from minister
-        if(vTipoCiclo[i] == 2 && vTipoReproduccion[i] == 2 && vTipoAdaptacion[i] == 4) {
-            
-            //restriction 1:
-            if(vRiesgo[i] == 1 || vRiesgo[i] == 2) {
-                fprintf(_nodonadas, "Semilla %d no se puede donar por ser de alto riego de extinction\n", seed_id);
-                can_donate = false;
-            }
+            if ((categorias & MASCARA_RIESGO) == RIESGO_EXTREMO << DESPL_RIESGO) { 
+                ag->count_total_riesgo_extremo++;
 
-            //restriction 2:
-            if(vNumSemillas[i] < 1000) {
-                fprintf(_nodonadas, "Semilla %d no se puede donar por tener menos de 1000 semillas en el banco\n", seed_id);
-                can_donate = false;
+                ag->count_by_type[tipo]++;
             }
 
-            //restriction 3:
-            if(vCaducidad[i] < 2030) {
-                fprintf(_nodonadas,"Semilla %d no se puede donar por caducar antes del año 2030\n", seed_id);
-                can_donate = false;
-            }
+            ag->count_by_type_total[tipo]++;
+        }
 
-            //restriction 4:
-            if((vNumSemillas[i] - (vNumSemillas[i] * 0.17)) < 500) {
-                fprintf(_nodonadas, "Semilla %d no se puede donar porque nos quedarian menos de 500 semillas\n", seed_id);
-                can_donate = false;
-            }
+        if (bioma) {
+            int biome_index = vSeccion[i] % 10;
+            ag->biomas[biome_index]++;
+        }
 
-            //if seed does not fall under UPV restrictions for donations, then donate them and write it to file:
-            if(can_donate) {
-                (*contadorDonadas)++;
-                fprintf(_donadas, "Semilla %d donada, quedan %.0f semillas en la muestra\n", seed_id, ceil(vNumSemillas[i] - (vNumSemillas[i] * 0.17)));
-            } else (*contadorNoDonadas)++;
+    }
+}
 
+//* Counts the donated and not donated seeds of the bitmap words [palabra_inicio, palabra_fin)
+static void cuenta_donacion(const FiltroDonacion *filtro, size_t palabra_inicio, size_t palabra_fin, Agregados *ag) {
+    for (size_t w = palabra_inicio; w < palabra_fin; w++) {
+        int cumplen = __builtin_popcountll(filtro->ministerio[w]);
+        int donadas = __builtin_popcountll(filtro->donadas[w]);
 
-        }
+        ag->contadorDonadas += donadas;
+        ag->contadorNoDonadas += cumplen - donadas;
+    }
+}
+
+//* State of one thread of recorre_banco
+//* Each thread counts into its own copy of the aggregates, aligned to a cache line so
+//* the threads never write to the same line.
+typedef struct {
+    _Alignas(64) Agregados ag;
+} ParteRecorrido;
+
+typedef struct {
+    const BancoSemillas *banco;
+    int informes;
+    FiltroDonacion *filtro;
+    ParteRecorrido *partes;
+} Recorrido;
+
+//* Runs every selected report on one part of the bank
+//* Parts start at multiples of 64 seeds, so each thread fills its own words of the bitmaps
+static void recorre_parte(void *contexto, size_t inicio, size_t fin, int hilo) {
+    Recorrido *recorrido = contexto;
+    Agregados *ag = &recorrido->partes[hilo].ag;
+
+    recorre_rango(recorrido->banco, recorrido->informes, inicio, fin, ag);
+
+    if ((recorrido->informes & INFORME_DONACION) && recorrido->filtro != NULL) {
+        filtra_donacion(recorrido->banco, recorrido->filtro, inicio, fin);
+        cuenta_donacion(recorrido->filtro, inicio / 64, (fin + 63) / 64, ag);
+    }
+}
+
+//* One pass over the bank that fills the aggregates of every report selected in `informes`
+//* (INFORME_* flags). With INFORME_DONACION the donation rules are also evaluated into
+//* `filtro` (see filtro_crea), and the listings are written from it afterwards.
+//* Big banks are split among num_hilos threads; the counters are integers added in a fixed
+//* order, so the results are the same as with one thread.
+void recorre_banco(const BancoSemillas *banco, int informes, FiltroDonacion *filtro, Agregados *ag) {
+
+    *ag = (Agregados) {0};
 
+    int hilos = hilos_para(banco->n_semillas);
+
+    ParteRecorrido partes[hilos];
+    memset(partes, 0, sizeof(partes));
+
+    Recorrido recorrido = {banco, informes, filtro, partes};
+
+    if (hilos == 1) {
+        recorre_parte(&recorrido, 0, banco->n_semillas, 0);
+    } else {
+        ejecuta_en_paralelo(banco->n_semillas, hilos, recorre_parte, &recorrido);
     }
 
+    // Merge the parts in order
+    for (int h = 0; h < hilos; h++) suma_agregados(ag, &partes[h].ag);
+}
+
+//* Function to allocate the bitmaps of the donation filter (one bit per slot of the bank)
+int filtro_crea(FiltroDonacion *filtro, const BancoSemillas *banco) {
+    size_t n_palabras = (banco->n_semillas + 63) / 64;
+
+    // The six bitmaps share one allocation
+    uint64_t *palabras = calloc(6 * n_palabras + 1, sizeof(uint64_t));
+    if (palabras == NULL) return -1;
 
-    fclose(_donadas);
-    fclose(_nodonadas);
+    filtro->n_palabras = n_palabras;
+    filtro->ministerio = palabras;
+    for (int r = 0; r < 4; r++) filtro->rechazo[r] = palabras + (1 + r) * n_palabras;
+    filtro->donadas = palabras + 5 * n_palabras;
     return 0;
 }
 
-//* Function to read data from the file "semillas.txt"
-int lee_datos(int vAnyo[], int vCaducidad[], int vNumSemillas[], int vSeccion[], int vRiesgo[], int vTipoCrecimiento[], int vTipoReproduccion[], int vTipoAdaptacion[], int vTipoCiclo[]){
-    FILE *file = fopen("semillas.txt", "r");
+//* Function to free the bitmaps of the donation filter
+void filtro_libera(FiltroDonacion *filtro) {
+    free(filtro->ministerio);
+    *filtro = (FiltroDonacion) {0};
+}
 
-    // Check if the file was successfully opened
-    if(file == NULL) {
-        return -1;
+//* Evaluates the donation rules on `n` seeds starting at `base` (n <= 64), one bit per seed
+//* Used for the last, incomplete block and where SSE2 is not available.
+static void filtra_bloque_escalar(const BancoSemillas *banco, size_t base, size_t n, uint64_t mascaras[6]) {
+    uint64_t ministerio = 0, r1 = 0, r2 = 0, r3 = 0, r4 = 0;
+
+    for (size_t k = 0; k < n; k++) {
+        size_t i = base + k;
+        uint16_t categorias = banco->vCategorias[i];
+
+        //check if seed meets donation creterias from minister (one comparison on the packed word)
+        ministerio |= (uint64_t) ((categorias & MASCARA_MINISTERIO) == CRITERIO_MINISTERIO) << k;
+
+        //restriction 1: high risk of extinction (empty slots never meet the criteria)
+        r1 |= (uint64_t) ((categorias & MASCARA_RIESGO) <= RIESGO_ALTO << DESPL_RIESGO) << k;
+        //restriction 2: small sample
+        r2 |= (uint64_t) (banco->vNumSemillas[i] < DONACION_MIN_SEMILLAS) << k;
+        //restriction 3: expires soon
+        r3 |= (uint64_t) (banco->vCaducidad[i] < DONACION_MIN_CADUCIDAD) << k;
+        //restriction 4: too few seeds left after donating
+        r4 |= (uint64_t) (banco->vNumSemillas[i] < DONACION_UMBRAL_RESTANTES) << k;
     }
 
-    int identificador;
-    int anyo, caducidad, numSemillas, seccion, riesgo, tipoCrecimiento, tipoReproduccion, tipoAdaptacion, tipoCiclo;
+    mascaras[0] = ministerio;
+    mascaras[1] = r1;
+    mascaras[2] = r2;
+    mascaras[3] = r3;
+    mascaras[4] = r4;
+}
 
-    // Read data line by line
-    while(fscanf(file, "%d %d %d %d %d %d %d %d %d %d", &identificador, &anyo, &caducidad, &numSemillas, &seccion,
-                  &riesgo, &tipoCrecimiento, &tipoReproduccion, &tipoAdaptacion, &tipoCiclo) == 10) {
+#if defined(__SSE2__)
+//* Same as filtra_bloque_escalar for a full block of 64 seeds, 16 seeds per instruction
+//* The comparisons give 0xFFFF/0xFFFFFFFF lanes that are narrowed to bytes with the
+//* saturating packs and turned into 16 bits of the mask with movemask. The categories are
+//* compared packed, 8 seeds per instruction and the three minister criteria at once.
+static void filtra_bloque_sse2(const BancoSemillas *banco, size_t base, uint64_t mascaras[6]) {
+    const __m128i mascara_ministerio = _mm_set1_epi16(MASCARA_MINISTERIO);
+    const __m128i criterio_ministerio = _mm_set1_epi16(CRITERIO_MINISTERIO);
+    const __m128i mascara_riesgo = _mm_set1_epi16(MASCARA_RIESGO);
+    const __m128i menos_que_medio = _mm_set1_epi16((RIESGO_ALTO + 1) << DESPL_RIESGO);
+    const __m128i min_semillas = _mm_set1_epi32(DONACION_MIN_SEMILLAS);
+    const __m128i umbral_restantes = _mm_set1_epi32(DONACION_UMBRAL_RESTANTES);
+    // Years are unsigned 16-bit: flipping the sign bit makes the signed comparison work
+    const __m128i signo = _mm_set1_epi16((short) 0x8000);
+    const __m128i min_caducidad = _mm_set1_epi16((short) (DONACION_MIN_CADUCIDAD ^ 0x8000));
+
+    uint64_t ministerio = 0, r1 = 0, r2 = 0, r3 = 0, r4 = 0;
+
+    for (int g = 0; g < 4; g++) {
+        size_t i = base + 16 * g;
+
+        __m128i cat0 = _mm_loadu_si128((const __m128i *) (banco->vCategorias + i));
+        __m128i cat1 = _mm_loadu_si128((const __m128i *) (banco->vCategorias + i + 8));
+
+        __m128i cumple = _mm_packs_epi16(
+            _mm_cmpeq_epi16(_mm_and_si128(cat0, mascara_ministerio), criterio_ministerio),
+            _mm_cmpeq_epi16(_mm_and_si128(cat1, mascara_ministerio), criterio_ministerio));
+        // riesgo <= RIESGO_ALTO (the fields are small, so the signed comparison is enough)
+        __m128i alto = _mm_packs_epi16(
+            _mm_cmplt_epi16(_mm_and_si128(cat0, mascara_riesgo), menos_que_medio),
+            _mm_cmplt_epi16(_mm_and_si128(cat1, mascara_riesgo), menos_que_medio));
+
+        __m128i n0 = _mm_loadu_si128((const __m128i *) (banco->vNumSemillas + i));
+        __m128i n1 = _mm_loadu_si128((const __m128i *) (banco->vNumSemillas + i + 4));
+        __m128i n2 = _mm_loadu_si128((const __m128i *) (banco->vNumSemillas + i + 8));
+        __m128i n3 = _mm_loadu_si128((const __m128i *) (banco->vNumSemillas + i + 12));
+
+        __m128i pocas = _mm_packs_epi16(
+            _mm_packs_epi32(_mm_cmplt_epi32(n0, min_semillas), _mm_cmplt_epi32(n1, min_semillas)),
+            _mm_packs_epi32(_mm_cmplt_epi32(n2, min_semillas), _mm_cmplt_epi32(n3, min_semillas)));
+        __m128i quedan_pocas = _mm_packs_epi16(
+            _mm_packs_epi32(_mm_cmplt_epi32(n0, umbral_restantes), _mm_cmplt_epi32(n1, umbral_restantes)),
+            _mm_packs_epi32(_mm_cmplt_epi32(n2, umbral_restantes), _mm_cmplt_epi32(n3, umbral_restantes)));
+
+        __m128i cad0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (banco->vCaducidad + i)), signo);
+        __m128i cad1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (banco->vCaducidad + i + 8)), signo);
+        __m128i caduca = _mm_packs_epi16(_mm_cmplt_epi16(cad0, min_caducidad), _mm_cmplt_epi16(cad1, min_caducidad));
+
+        int desplazamiento = 16 * g;
+        ministerio |= (uint64_t) (uint16_t) _mm_movemask_epi8(cumple) << desplazamiento;
+        r1 |= (uint64_t) (uint16_t) _mm_movemask_epi8(alto) << desplazamiento;
+        r2 |= (uint64_t) (uint16_t) _mm_movemask_epi8(pocas) << desplazamiento;
+        r3 |= (uint64_t) (uint16_t) _mm_movemask_epi8(caduca) << desplazamiento;
+        r4 |= (uint64_t) (uint16_t) _mm_movemask_epi8(quedan_pocas) << desplazamiento;
+    }
 
-        //the index of each type of seed is its identifier - 1            
-        int index = identificador - 1;
+    mascaras[0] = ministerio;
+    mascaras[1] = r1;
+    mascaras[2] = r2;
+    mascaras[3] = r3;
+    mascaras[4] = r4;
+}
+#endif
+
+//* Function to evaluate the donation rules on the seeds [inicio, fin) (inicio multiple of 64)
+//* Every rule is computed for 64 seeds at a time as a mask, without branches; the masks
+//* are then combined into the rejection and donation bitmaps.
+void filtra_donacion(const BancoSemillas *banco, FiltroDonacion *filtro, size_t inicio, size_t fin) {
+    for (size_t base = inicio; base < fin; base += 64) {
+        uint64_t mascaras[6];
+        size_t n = fin - base < 64 ? fin - base : 64;
+
+#if defined(__SSE2__)
+        if (n == 64) filtra_bloque_sse2(banco, base, mascaras);
+        else filtra_bloque_escalar(banco, base, n, mascaras);
+#else
+        filtra_bloque_escalar(banco, base, n, mascaras);
+#endif
+
+        size_t w = base / 64;
+        uint64_t ministerio = mascaras[0];
+        uint64_t rechazadas = 0;
+
+        for (int r = 0; r < 4; r++) {
+            filtro->rechazo[r][w] = mascaras[1 + r] & ministerio;
+            rechazadas |= filtro->rechazo[r][w];
+        }
 
-        vAnyo[index] = anyo;
-        vCaducidad[index] = caducidad;
-        vNumSemillas[index] = numSemillas;
-        vSeccion[index] = seccion;
-        vRiesgo[index] = riesgo;
-        vTipoCrecimiento[index] = tipoCrecimiento;
-        vTipoReproduccion[index] = tipoReproduccion;
-        vTipoAdaptacion[index] = tipoAdaptacion;
-        vTipoCiclo[index] = tipoCiclo;
+        filtro->ministerio[w] = ministerio;
+        filtro->donadas[w] = ministerio & ~rechazadas;
     }
+}
 
-    fclose(file); // Close the file
-    return 0;     // Return success
+//* Writes the line of donadas.txt of the seed with index i
+static void escribe_donada(const BancoSemillas *banco, size_t i, Escritor *file) {
+    ESCRIBE(file, "Semilla ");
+    escritor_entero(file, banco->id_base + i + 1);
+    ESCRIBE(file, " donada, quedan ");
+    escritor_entero(file, semillas_tras_donar(banco->vNumSemillas[i]));
+    ESCRIBE(file, " semillas en la muestra\n");
 }
 
+//* Function to write donadas.txt and nodonadas.txt from the donation bitmaps
+//* Only the seeds that meet the minister criteria are visited, in identifier order.
+void escribe_donacion(const BancoSemillas *banco, const FiltroDonacion *filtro, Escritor *donadas, Escritor *nodonadas) {
+    #define MOTIVO(texto) {texto, sizeof(texto) - 1}
+    static const struct { const char *texto; size_t len; } motivos[4] = {
+        MOTIVO(" no se puede donar por ser de alto riego de extinction\n"),
+        MOTIVO(" no se puede donar por tener menos de 1000 semillas en el banco\n"),
+        MOTIVO(" no se puede donar por caducar antes del año 2030\n"),
+        MOTIVO(" no se puede donar porque nos quedarian menos de 500 semillas\n")
+    };
+    #undef MOTIVO
 
-//* Menu function with input validation
-void menu(int *memory_of_menu_option) {
+    for (size_t w = 0; w < filtro->n_palabras; w++) {
+        uint64_t palabra = filtro->ministerio[w];
 
-        printf("\n\n");
-        printf("--------------- Menu de opciones -----------------------\n");
-        printf("1. Semillas de especies en peligro de extincion.\n");
-        printf("2. Caducidad de semillas.\n");
-        printf("3. Bioma con mayor porcentaje de especies en el banco.\n");
-        printf("4. Donacion de semillas.\n");
+        while (palabra != 0) {
+            int k = __builtin_ctzll(palabra);
+            uint64_t bit = (uint64_t) 1 << k;
+            palabra &= palabra - 1;
+
+            size_t i = w * 64 + k;
+            long long seed_id = (long long) (banco->id_base + i) + 1;
+
+            for (int r = 0; r < 4; r++) {
+                if (filtro->rechazo[r][w] & bit) {
+                    ESCRIBE(nodonadas, "Semilla ");
+                    escritor_entero(nodonadas, seed_id);
+                    escritor_texto(nodonadas, motivos[r].texto, motivos[r].len);
+                }
+            }
+
+            //if seed does not fall under UPV restrictions for donations, then donate them and write it to file:
+            if (filtro->donadas[w] & bit) escribe_donada(banco, i, donadas);
+        }
+    }
+}
+
+//* Function to process seeds in danger of extinction
+//* The counts are rolled up from the cube, so no scan is needed
+void peligro_extincion(const Cubo *cubo) {
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_PELIGRO);
+
+    Agregados ag = {0};
+    cubo_agregados(cubo, &ag);
+
+    imprime_peligro_extincion(&ag);
+
+    tramo_cierra(&tramo, 0, ag.count_total_riesgo_extremo);
+}
+
+//* Prints the seeds in danger of extinction by plant type
+void imprime_peligro_extincion(const Agregados *ag) {
+
+    float percentages[NUM_OF_TYPES_OF_SEEDS] = {0}; // Index 0: ARBOL - 1, 1: ARBUSTO - 1, 2: HIERBA - 1, 3: PLANTA_TREPADORA - 1
+
+    const char *type_names[] = {"arboles", "arbustos", "hierbas", "plantas trepadoras"};
+
+    //prevents division by 0
+    if(ag->count_total_riesgo_extremo == 0) {
+        printf("Hay 0 especies en peligro de extincion");
+        return;
+    } 
+
+
+    for (int i = 0; i < NUM_OF_TYPES_OF_SEEDS; i++) {
+        percentages[i] = (ag->count_by_type[i] / (float) ag->count_by_type_total[i] * 100);
+    }
+
+    //Find type with highest risk:
+    int index_of_highest_risk = 0;
+
+    for (int i = 0; i < NUM_OF_TYPES_OF_SEEDS; i++) {
+        if(percentages[i] > percentages[index_of_highest_risk]) index_of_highest_risk = i;
+    }
+
+
+    // Print the total number of endangered species
+    printf("Hay %d especies en peligro de extincion:\n", ag->count_total_riesgo_extremo);
+
+    // Print the breakdown of endangered species by plant type
+    for (int i = 0; i < NUM_OF_TYPES_OF_SEEDS; i ++) {
+            printf("    %d %s (%.1f%% del total de %s)\n", ag->count_by_type[i], type_names[i], percentages[i], type_names[i]);
+    }
+
+    // Print the plant type with the highest percentage of endangered species
+    printf("\nEl mayor porcentaje de especies en peligro de extincion corresponde a %s (%.1f%% del total de %s)\n", type_names[index_of_highest_risk], percentages[index_of_highest_risk], type_names[index_of_highest_risk]);
+
+}
+
+//* Asks the user for the range of expiration years
+void pide_rango_anyos(int *start_year, int *end_year) {
+
+    // Get the start year (with input validation)
+    do {
+        printf("Introduce el anyo de inicio: ");
+        if (scanf("%d", start_year) != 1 || *start_year < 2020) {
+            printf("Entrada invalida. El anyo de inicio debe ser un numero entero mayor o igual a 2020.\n");
+            while (getchar() != '\n'); // Clear invalid input from the buffer
+            *start_year = -1; 
+        }
+    } while (*start_year < 2020);
+
+    // Get the end year (with input validation)
+    do {
+        printf("Introduce el anyo de finalizacion: ");
+        if (scanf("%d", end_year) != 1 || *end_year < *start_year) {
+            printf("Entrada invalida. El anyo de finalizacion debe ser un numero entero mayor o igual al anyo de inicio.\n");
+            while (getchar() != '\n'); // Clear invalid input from the buffer
+            *end_year = -1;
+        }
+    } while (*end_year < *start_year);
+}
+
+//* Function to calculate seed expiration
+//* Totals come from the expiration index and only the seeds in the range are visited
+int caducidad_semillas(const BancoSemillas *banco, const IndiceCaducidad *indice, int start_year, int end_year, const char *ruta) {
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_CADUCIDAD);
+
+    Escritor file;
+
+    if (escritor_abre(&file, ruta) == -1) {
+        return -1; // Return error code if the file couldn't be created
+    }
+
+    Agregados ag = {0};
+    indice_cuenta(indice, start_year, end_year, &ag);
+
+    int resultado = escribe_caducadas(banco, indice, start_year, end_year, &file);
+
+    if (escritor_cierra(&file) == -1 || resultado == -1) return -1;
+
+    // With the index only the seeds in the range are read; after a delta file the bank is scanned
+    tramo_cierra(&tramo, indice->ordenado ? (size_t) ag.count_total_expired_seeds : banco->n_semillas,
+                 ag.count_total_expired_seeds);
+
+    return imprime_caducidad(&ag, banco->n_vivas);
+}
+
+//* Prints the expired seeds and samples; returns -1 if the bank has no samples
+int imprime_caducidad(const Agregados *ag, size_t n_vivas) {
+
+    // Prevent division by zero (just in case)
+    if (ag->count_total_seed_samples == 0) {
+        printf("Error: No hay muestras de semillas en el banco.\n");
+        return -1;
+    }
+
+    // Calculate percentages
+    float percentage_of_total_expired_seeds = ag->count_total_expired_seeds / (float) n_vivas * 100;
+    float percentage_of_total_expired_seed_samples = ag->count_total_expired_seed_samples / (float) ag->count_total_seed_samples * 100;
+
+    // Display results to the user
+    printf("Cantidad de muestras de semillas caducadas: %lld (%.1f%% del total)\n",
+           ag->count_total_expired_seed_samples, percentage_of_total_expired_seed_samples);
+    printf("Numero de semillas caducadas: %d (%.1f%% del total)\n",
+           ag->count_total_expired_seeds, percentage_of_total_expired_seeds);
+
+    return 0;
+}
+
+//* Function to find the biome with the highest percentage of species
+//* The seeds per biome are rolled up from the cube; only the listing reads the bank
+int especies_bioma(const BancoSemillas *banco, const Cubo *cubo, const char *ruta) {
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_BIOMA);
+
+    Escritor file;
+
+    if(escritor_abre(&file, ruta) == -1) return -1;
+
+    Agregados ag = {0};
+    cubo_agregados(cubo, &ag);
+
+    imprime_bioma(banco, &ag, &file);
+
+    int resultado = escritor_cierra(&file);
+
+    tramo_cierra(&tramo, banco->n_semillas, ag.biomas[bioma_mayor(&ag)]);
+    return resultado;
+}
+
+//* Writes the seeds of the biome with most seeds to the file and prints the biome
+void imprime_bioma(const BancoSemillas *banco, const Agregados *ag, Escritor *file) {
+
+    escribe_bioma(banco, bioma_mayor(ag), file);
+
+    imprime_bioma_mayor(ag, banco->n_vivas);
+}
+
+//* Prints the biome with most seeds out of n_vivas
+void imprime_bioma_mayor(const Agregados *ag, size_t n_vivas) {
+
+    int index_of_highest_biome = bioma_mayor(ag);
+
+    float percentage_of_highest_biome = (ag->biomas[index_of_highest_biome] / (float) n_vivas) * 100;
+
+    printf("El bioma con mayor porcentaje de semillas en el banco es %d: %s (semillas %d, %.1f%% del total)\n", index_of_highest_biome + 1 ,bioma_names[index_of_highest_biome], ag->biomas[index_of_highest_biome], percentage_of_highest_biome);
+}
+
+//* Returns the index of the biome with most seeds (the first one if several tie)
+int bioma_mayor(const Agregados *ag) {
+
+    int index_of_highest_biome = 0;
+
+    for (int i = 0; i < N_BIOMAS; i++) {
+        if (ag->biomas[i] > ag->biomas[index_of_highest_biome]) {
+            index_of_highest_biome = i;
+        }
+    }
+
+    return index_of_highest_biome;
+}
+
+//* Function to write the seeds of one biome to bioma.txt, in identifier order
+void escribe_bioma(const BancoSemillas *banco, int bioma, Escritor *file) {
+
+    ESCRIBE(file, "Semillas del bioma ");
+    escritor_texto(file, bioma_names[bioma], strlen(bioma_names[bioma]));
+    ESCRIBE(file, " \n\n");
+
+    escribe_semillas_bioma(banco, bioma, file);
+}
+
+//* Writes the lines of bioma.txt of the seeds of one biome, without the header
+void escribe_semillas_bioma(const BancoSemillas *banco, int bioma, Escritor *file) {
+
+    const uint8_t *vSeccion = banco->vSeccion;
+    const uint16_t *vCategorias = banco->vCategorias;
+
+    for (size_t i = 0; i < banco->n_semillas; i ++) {
+
+        int biome_index = vSeccion[i] % 10;
+
+        if(biome_index == bioma && vCategorias[i] != SLOT_VACIO) {
+            ESCRIBE(file, "Semilla ");
+            escritor_entero(file, banco->id_base + i + 1);
+            ESCRIBE(file, ": entrada ");
+            escritor_entero(file, banco->vAnyo[i]);
+            ESCRIBE(file, " caducidad ");
+            escritor_entero(file, banco->vCaducidad[i]);
+            ESCRIBE(file, "\n");
+        }
+    }
+}
+
+//* Function to process seed donation
+int donacion(const BancoSemillas *banco, const char *ruta_donadas, const char *ruta_nodonadas, int* contadorDonadas, int* contadorNoDonadas) {
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_DONACION);
+
+    Escritor _donadas, _nodonadas;
+
+    if(escritor_abre(&_donadas, ruta_donadas) == -1) return -1;
+    if(escritor_abre(&_nodonadas, ruta_nodonadas) == -1) {
+        escritor_cierra(&_donadas);
+        return -1;
+    }
+
+    FiltroDonacion filtro;
+    if (filtro_crea(&filtro, banco) == -1) {
+        escritor_cierra(&_donadas);
+        escritor_cierra(&_nodonadas);
+        return -1;
+    }
+
+    // Empty slots have every type set to 0, so they never meet the minister criteria
+    Agregados ag;
+    recorre_banco(banco, INFORME_DONACION, &filtro, &ag);
+    escribe_donacion(banco, &filtro, &_donadas, &_nodonadas);
+    filtro_libera(&filtro);
+
+    *contadorDonadas = ag.contadorDonadas;
+    *contadorNoDonadas = ag.contadorNoDonadas;
+
+    int resultado = 0;
+    if (escritor_cierra(&_donadas) == -1) resultado = -1;
+    if (escritor_cierra(&_nodonadas) == -1) resultado = -1;
+
+    tramo_cierra(&tramo, banco->n_semillas, ag.contadorDonadas + ag.contadorNoDonadas);
+    return resultado;
+}
+
+//* Prints how many seeds meet the minister criteria and how many of them are donated
+void imprime_donacion(int contadorDonadas, int contadorNoDonadas, size_t n_vivas) {
+    int total = contadorDonadas + contadorNoDonadas;
+    printf("Semillas que cumplen las condiciones %d (%.1f%%):\n", total, total / (float) n_vivas * 100);
+    printf("    Donadas %d (%.1f%%)\n", contadorDonadas, contadorDonadas / (float) n_vivas * 100);
+    printf("    No donadas %d (%.1f%%)\n", contadorNoDonadas, contadorNoDonadas / (float) n_vivas * 100);
+}
+
+//* Function to run the four reports with a single pass over the bank
+int todos_los_informes(const BancoSemillas *banco, const IndiceCaducidad *indice, const Cubo *cubo, const Agregados *resumen, int start_year, int end_year) {
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_TODOS);
+
+    const char *rutas[] = {"caducadas.txt", "bioma.txt", "donadas.txt", "nodonadas.txt"};
+    Escritor salidas[4];
+
+    for (int f = 0; f < 4; f++) {
+        if (escritor_abre(&salidas[f], rutas[f]) == -1) {
+            while (--f >= 0) escritor_cierra(&salidas[f]);
+            return -1;
+        }
+    }
+
+    Escritor *caducadas = &salidas[0], *bioma = &salidas[1], *_donadas = &salidas[2], *_nodonadas = &salidas[3];
+
+    FiltroDonacion filtro;
+    if (filtro_crea(&filtro, banco) == -1) {
+        for (int f = 0; f < 4; f++) escritor_cierra(&salidas[f]);
+        return -1;
+    }
+
+    // Risk and biome counts come from the cube, donation counts from the summary and seed
+    // expiration from the index; only the donation bitmaps need a pass over the bank
+    Agregados ag = *resumen, pasada;
+    cubo_agregados(cubo, &ag);
+    recorre_banco(banco, INFORME_DONACION, &filtro, &pasada);
+    indice_cuenta(indice, start_year, end_year, &ag);
+
+    escribe_donacion(banco, &filtro, _donadas, _nodonadas);
+    filtro_libera(&filtro);
+
+    int resultado = 0;
+
+    if (escribe_caducadas(banco, indice, start_year, end_year, caducadas) == -1) resultado = -1;
+
+    printf("\n");
+    imprime_peligro_extincion(&ag);
+
+    printf("\n\n");
+    if (imprime_caducidad(&ag, banco->n_vivas) == -1) resultado = -1;
+
+    // bioma.txt needs the winning biome first, so its listing is a second (narrow) pass
+    printf("\n");
+    imprime_bioma(banco, &ag, bioma);
+
+    printf("\n");
+    imprime_donacion(ag.contadorDonadas, ag.contadorNoDonadas, banco->n_vivas);
+
+    for (int f = 0; f < 4; f++) {
+        if (escritor_cierra(&salidas[f]) == -1) resultado = -1;
+    }
+
+    // Two passes over the bank: the donation bitmaps and the listing of bioma.txt
+    tramo_cierra(&tramo, 2 * banco->n_semillas, ag.count_total_expired_seeds + ag.biomas[bioma_mayor(&ag)] +
+                 ag.contadorDonadas + ag.contadorNoDonadas);
+    return resultado;
+}
+
+//* Function to create the report file `ruta` and a buffered writer for it
+int escritor_abre(Escritor *escritor, const char *ruta) {
+    *escritor = (Escritor) {0};
+    escritor->metrica = -1;
+
+    escritor->fd = open(ruta, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (escritor->fd == -1) return -1;
+
+    escritor->buffer = malloc(TAM_BUFFER_INFORME);
+    if (escritor->buffer == NULL) {
+        close(escritor->fd);
+        return -1;
+    }
+
+    escritor->capacidad = TAM_BUFFER_INFORME;
+
+    escritor->metrica = metrica_fichero(ruta);
+    if (escritor->metrica != -1) {
+        metricas.ficheros[escritor->metrica].aperturas++;
+        escritor->abierto = reloj_segundos();
+    }
+    return 0;
+}
+
+//* Function to create a writer that keeps its text in memory
+int escritor_en_memoria(Escritor *escritor) {
+    *escritor = (Escritor) {0};
+    escritor->fd = -1;
+    escritor->metrica = -1;
+
+    escritor->buffer = malloc(TAM_BUFFER_MEMORIA);
+    if (escritor->buffer == NULL) return -1;
+
+    escritor->capacidad = TAM_BUFFER_MEMORIA;
+    return 0;
+}
+
+//* Writes len bytes to the file of the writer, retrying short writes
+static void escribe_todo(Escritor *escritor, const char *texto, size_t len) {
+    MetricaFichero *metrica = escritor->metrica != -1 ? &metricas.ficheros[escritor->metrica] : NULL;
+
+    while (len > 0) {
+        double inicio = metrica != NULL ? reloj_segundos() : 0;
+        ssize_t escritos = write(escritor->fd, texto, len);
+        if (metrica != NULL) metrica->segundos_write += reloj_segundos() - inicio;
+
+        if (escritos == -1) {
+            if (errno == EINTR) continue;
+            escritor->error = true;
+            return;
+        }
+
+        if (metrica != NULL) metrica->bytes += escritos;
+        texto += escritos;
+        len -= escritos;
+    }
+}
+
+//* Makes room for len more bytes in the buffer (writing it to the file or growing it in memory)
+//* Returns false if the text does not fit and has to be written directly
+static bool escritor_hueco(Escritor *escritor, size_t len) {
+    if (escritor->usado + len <= escritor->capacidad) return true;
+
+    if (escritor->fd != -1) {
+        escribe_todo(escritor, escritor->buffer, escritor->usado);
+        escritor->usado = 0;
+        return len <= escritor->capacidad;
+    }
+
+    size_t nueva_capacidad = escritor->capacidad * 2;
+    while (nueva_capacidad < escritor->usado + len) nueva_capacidad *= 2;
+
+    char *nuevo = realloc(escritor->buffer, nueva_capacidad);
+    if (nuevo == NULL) {
+        escritor->error = true;
+        return false;
+    }
+
+    escritor->buffer = nuevo;
+    escritor->capacidad = nueva_capacidad;
+    return true;
+}
+
+//* Function to append len bytes of text to a report writer
+void escritor_texto(Escritor *escritor, const char *texto, size_t len) {
+    if (escritor_hueco(escritor, len)) {
+        memcpy(escritor->buffer + escritor->usado, texto, len);
+        escritor->usado += len;
+    } else if (escritor->fd != -1) {
+        escribe_todo(escritor, texto, len); // Bigger than the whole buffer (e.g. a thread's text)
+    }
+}
+
+//* Function to append a number in decimal to a report writer
+//* Digits are produced two at a time from a table, right to left
+void escritor_entero(Escritor *escritor, long long n) {
+    static const char pares[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    char digitos[24];
+    char *p = digitos + sizeof(digitos);
+
+    unsigned long long valor = n < 0 ? 0ULL - (unsigned long long) n : (unsigned long long) n;
+
+    while (valor >= 100) {
+        unsigned resto = valor % 100;
+        valor /= 100;
+        p -= 2;
+        memcpy(p, &pares[resto * 2], 2);
+    }
+
+    if (valor >= 10) {
+        p -= 2;
+        memcpy(p, &pares[valor * 2], 2);
+    } else {
+        *--p = (char) ('0' + valor);
+    }
+
+    if (n < 0) *--p = '-';
+
+    escritor_texto(escritor, p, digitos + sizeof(digitos) - p);
+}
+
+//* Function to write the buffered text, close the file and free the buffer
+//* Returns -1 if any write or allocation of this writer failed
+int escritor_cierra(Escritor *escritor) {
+    if (escritor->fd != -1) {
+        escribe_todo(escritor, escritor->buffer, escritor->usado);
+        if (close(escritor->fd) == -1) escritor->error = true;
+    }
+
+    free(escritor->buffer);
+
+    if (escritor->metrica != -1) metricas.ficheros[escritor->metrica].segundos += reloj_segundos() - escritor->abierto;
+
+    int resultado = escritor->error ? -1 : 0;
+    *escritor = (Escritor) {0};
+    escritor->fd = -1;
+    escritor->metrica = -1;
+    return resultado;
+}
+
+//* Function to build the expiration year index of the bank
+//* Seeds are placed by counting sort, so inside each year they keep identifier order
+int indice_construye(IndiceCaducidad *indice, const BancoSemillas *banco) {
+
+    *indice = (IndiceCaducidad) {0};
+
+    const uint16_t *vCaducidad = banco->vCaducidad;
+    const int32_t *vNumSemillas = banco->vNumSemillas;
+    const uint16_t *vCategorias = banco->vCategorias;
+
+    // Find the range of expiration years
+    int anyo_min = UINT16_MAX, anyo_max = 0;
+    for (size_t i = 0; i < banco->n_semillas; i++) {
+        if (vCategorias[i] == SLOT_VACIO) continue; // No seed with this identifier
+
+        if (vCaducidad[i] < anyo_min) anyo_min = vCaducidad[i];
+        if (vCaducidad[i] > anyo_max) anyo_max = vCaducidad[i];
+    }
+
+    indice->anyo_min = anyo_min;
+    indice->n_anyos = anyo_max >= anyo_min ? anyo_max - anyo_min + 1 : 0;
+
+    indice->semillas_hasta = calloc(indice->n_anyos + 1, sizeof(size_t));
+    indice->muestras_hasta = calloc(indice->n_anyos + 1, sizeof(long long));
+    indice->indices = malloc((banco->n_vivas > 0 ? banco->n_vivas : 1) * sizeof(uint32_t));
+
+    if (indice->semillas_hasta == NULL || indice->muestras_hasta == NULL || indice->indices == NULL) {
+        indice_libera(indice);
+        return -1;
+    }
+
+    // Histogram of seeds and samples by year (shifted one position to become prefix sums)
+    for (size_t i = 0; i < banco->n_semillas; i++) {
+        if (vCategorias[i] == SLOT_VACIO) continue;
+
+        int k = vCaducidad[i] - anyo_min;
+        indice->semillas_hasta[k + 1]++;
+        indice->muestras_hasta[k + 1] += vNumSemillas[i];
+    }
+
+    for (int k = 0; k < indice->n_anyos; k++) {
+        indice->semillas_hasta[k + 1] += indice->semillas_hasta[k];
+        indice->muestras_hasta[k + 1] += indice->muestras_hasta[k];
+    }
+
+    // Place every seed in its year (the prefix sums give where each year starts)
+    size_t *siguiente = malloc((indice->n_anyos > 0 ? indice->n_anyos : 1) * sizeof(size_t));
+    if (siguiente == NULL) {
+        indice_libera(indice);
+        return -1;
+    }
+    memcpy(siguiente, indice->semillas_hasta, indice->n_anyos * sizeof(size_t));
+
+    for (size_t i = 0; i < banco->n_semillas; i++) {
+        if (vCategorias[i] == SLOT_VACIO) continue;
+
+        indice->indices[siguiente[vCaducidad[i] - anyo_min]++] = (uint32_t) i;
+    }
+
+    free(siguiente);
+    indice->ordenado = true;
+    return 0;
+}
+
+//* Function to free the arrays of the expiration year index
+void indice_libera(IndiceCaducidad *indice) {
+    free(indice->semillas_hasta);
+    free(indice->muestras_hasta);
+    free(indice->indices);
+    *indice = (IndiceCaducidad) {0};
+}
+
+//* Converts a range of years into the positions [k_inicio, k_fin) of the prefix sums
+static void indice_rango(const IndiceCaducidad *indice, int start_year, int end_year, int *k_inicio, int *k_fin) {
+    *k_inicio = start_year - indice->anyo_min;
+    *k_fin = end_year - indice->anyo_min + 1;
+
+    // Years outside the bank have no seeds
+    if (*k_inicio < 0) *k_inicio = 0;
+    if (*k_fin > indice->n_anyos) *k_fin = indice->n_anyos;
+    if (*k_fin < *k_inicio) *k_fin = *k_inicio;
+}
+
+//* Function to fill the expiration aggregates for a range of years from the prefix sums
+void indice_cuenta(const IndiceCaducidad *indice, int start_year, int end_year, Agregados *ag) {
+    int k_inicio, k_fin;
+    indice_rango(indice, start_year, end_year, &k_inicio, &k_fin);
+
+    ag->count_total_expired_seeds = (int) (indice->semillas_hasta[k_fin] - indice->semillas_hasta[k_inicio]);
+    ag->count_total_expired_seed_samples = indice->muestras_hasta[k_fin] - indice->muestras_hasta[k_inicio];
+    ag->count_total_seed_samples = indice->muestras_hasta[indice->n_anyos];
+}
+
+//* Writes the line of caducadas.txt of the seed with index i
+static void escribe_caducada(const BancoSemillas *banco, size_t i, Escritor *file) {
+    ESCRIBE(file, "Semilla ");
+    escritor_entero(file, banco->id_base + i + 1);
+    ESCRIBE(file, ": anyo de entrada ");
+    escritor_entero(file, banco->vAnyo[i]);
+    ESCRIBE(file, " anyo de caducidad ");
+    escritor_entero(file, banco->vCaducidad[i]);
+    ESCRIBE(file, " (muestra ");
+    escritor_entero(file, banco->vNumSemillas[i]);
+    ESCRIBE(file, ")\n");
+}
+
+//* Function to write the seeds expiring in a range of years to caducadas.txt
+//* The seeds of the range are marked in a bitmap and then written in identifier order,
+//* so the file is the same as with a full scan but only the matching seeds are read.
+//* After a delta file `indices` is out of date and the bank is scanned instead.
+int escribe_caducadas(const BancoSemillas *banco, const IndiceCaducidad *indice, int start_year, int end_year, Escritor *file) {
+    int k_inicio, k_fin;
+    indice_rango(indice, start_year, end_year, &k_inicio, &k_fin);
+
+    size_t desde = indice->semillas_hasta[k_inicio];
+    size_t hasta = indice->semillas_hasta[k_fin];
+
+    if (desde == hasta) return 0; // No seed expires in the range
+
+    if (!indice->ordenado) {
+        for (size_t i = 0; i < banco->n_semillas; i++) {
+            if (banco->vCategorias[i] != SLOT_VACIO && banco->vCaducidad[i] >= start_year && banco->vCaducidad[i] <= end_year) {
+                escribe_caducada(banco, i, file);
+            }
+        }
+        return 0;
+    }
+
+    size_t n_palabras = (banco->n_semillas + 63) / 64;
+    uint64_t *marcadas = calloc(n_palabras, sizeof(uint64_t));
+    if (marcadas == NULL) return -1;
+
+    for (size_t j = desde; j < hasta; j++) {
+        uint32_t i = indice->indices[j];
+        marcadas[i / 64] |= (uint64_t) 1 << (i % 64);
+    }
+
+    for (size_t w = 0; w < n_palabras; w++) {
+        uint64_t palabra = marcadas[w];
+
+        while (palabra != 0) {
+            size_t i = w * 64 + __builtin_ctzll(palabra);
+            palabra &= palabra - 1; // Clear the lowest set bit
+
+            // Write seed details to the file
+            escribe_caducada(banco, i, file);
+        }
+    }
+
+    free(marcadas);
+    return 0;
+}
+
+//* Sort key of the seed with index i: smaller keys go first (descending orders are complemented)
+static uint32_t clave_orden(const BancoSemillas *banco, size_t i, int orden) {
+    int32_t muestra = banco->vNumSemillas[i] > 0 ? banco->vNumSemillas[i] : 0;
+
+    switch (orden) {
+        case ORDEN_CADUCIDAD: return banco->vCaducidad[i];
+        case ORDEN_RESTANTES: return UINT32_MAX - (uint32_t) semillas_tras_donar(muestra);
+        case ORDEN_MUESTRA: return UINT32_MAX - (uint32_t) muestra;
+        default: return banco->vSeccion[i];
+    }
+}
+
+//* Pairs (key << 32 | index) of the seeds set in a bitmap, in identifier order
+static size_t pares_de_bitmap(const BancoSemillas *banco, const uint64_t *mapa, size_t n_palabras, int orden, uint64_t *pares) {
+    size_t n = 0;
+
+    for (size_t w = 0; w < n_palabras; w++) {
+        for (uint64_t palabra = mapa[w]; palabra != 0; palabra &= palabra - 1) {
+            size_t i = w * 64 + __builtin_ctzll(palabra);
+            pares[n++] = (uint64_t) clave_orden(banco, i, orden) << 32 | i;
+        }
+    }
+    return n;
+}
+
+//* One pass of the radix sort, shared by the threads: digit of bits [desplazamiento, desplazamiento + 8)
+typedef struct {
+    const uint64_t *origen;
+    uint64_t *destino;
+    int desplazamiento;
+    size_t (*cuentas)[256];   // [hilo][digito]: seeds of the part of the thread, then where they go
+} PasadaRadix;
+
+//* Histogram of the digits of the part [inicio, fin)
+static void radix_cuenta(void *contexto, size_t inicio, size_t fin, int hilo) {
+    PasadaRadix *pasada = contexto;
+    size_t *cuenta = pasada->cuentas[hilo];
+
+    memset(cuenta, 0, 256 * sizeof(size_t));
+    for (size_t j = inicio; j < fin; j++) cuenta[pasada->origen[j] >> pasada->desplazamiento & 0xFF]++;
+}
+
+//* Moves the part [inicio, fin) to its place (cuentas already holds the first position of each digit)
+static void radix_reparte(void *contexto, size_t inicio, size_t fin, int hilo) {
+    PasadaRadix *pasada = contexto;
+    size_t *siguiente = pasada->cuentas[hilo];
+
+    for (size_t j = inicio; j < fin; j++) {
+        uint64_t par = pasada->origen[j];
+        pasada->destino[siguiente[par >> pasada->desplazamiento & 0xFF]++] = par;
+    }
+}
+
+//* Sorts the pairs by their key with a stable LSD radix sort on the four bytes of the key
+//* Each pass counts and moves the parts of the threads in order, so the result does not depend
+//* on the threads, and the identifier order of the input breaks the ties. Passes whose digit is
+//* the same for every pair (e.g. the high bytes of the years) are skipped.
+//* Returns the sorted array (pares or aux), or NULL without memory
+static uint64_t *ordena_pares(uint64_t *pares, uint64_t *aux, size_t n) {
+    int hilos = hilos_para(n);
+    size_t (*cuentas)[256] = malloc(hilos * sizeof(*cuentas));
+    if (cuentas == NULL) return NULL;
+
+    for (int desplazamiento = 32; desplazamiento < 64; desplazamiento += 8) {
+        PasadaRadix pasada = {pares, aux, desplazamiento, cuentas};
+        ejecuta_en_paralelo(n, hilos, radix_cuenta, &pasada);
+
+        // First position of each digit for each part: digits in order, and parts in order inside each digit
+        size_t posicion = 0;
+        bool un_digito = false;
+
+        for (int d = 0; d < 256; d++) {
+            size_t del_digito = 0;
+            for (int h = 0; h < hilos; h++) {
+                size_t cuenta = cuentas[h][d];
+                cuentas[h][d] = posicion;
+                posicion += cuenta;
+                del_digito += cuenta;
+            }
+            if (del_digito == n) un_digito = true;
+        }
+
+        if (un_digito) continue;
+
+        ejecuta_en_paralelo(n, hilos, radix_reparte, &pasada);
+
+        uint64_t *tmp = pares;
+        pares = aux;
+        aux = tmp;
+    }
+
+    free(cuentas);
+    return pares;
+}
+
+//* Moves the pair at position j of the max-heap down to its place
+static void monticulo_hunde(uint64_t *monticulo, size_t n, size_t j) {
+    for (;;) {
+        size_t mayor = j, hijo = 2 * j + 1;
+
+        if (hijo < n && monticulo[hijo] > monticulo[mayor]) mayor = hijo;
+        if (hijo + 1 < n && monticulo[hijo + 1] > monticulo[mayor]) mayor = hijo + 1;
+        if (mayor == j) return;
+
+        uint64_t tmp = monticulo[j];
+        monticulo[j] = monticulo[mayor];
+        monticulo[mayor] = tmp;
+        j = mayor;
+    }
+}
+
+//* Keeps the k smallest pairs in the first k positions of `pares`, sorted
+//* A max-heap of k pairs holds the best ones seen so far; each new pair is compared with its
+//* root, the worst of them, so most pairs cost one comparison. The heap is then heap-sorted.
+static void top_k_pares(uint64_t *pares, size_t n, size_t k) {
+    for (size_t j = k / 2; j-- > 0;) monticulo_hunde(pares, k, j);
+
+    for (size_t j = k; j < n; j++) {
+        if (pares[j] < pares[0]) {
+            pares[0] = pares[j];
+            monticulo_hunde(pares, k, 0);
+        }
+    }
+
+    for (size_t m = k; m > 1; m--) {
+        uint64_t tmp = pares[0];
+        pares[0] = pares[m - 1];
+        pares[m - 1] = tmp;
+        monticulo_hunde(pares, m - 1, 0);
+    }
+}
+
+//* Function to write the seeds of caducadas.txt or donadas.txt sorted by a key (ORDEN_*)
+//* Only the (key, index) pairs of the listed seeds are sorted, never the text: small top-K
+//* lists keep a heap, the rest go through the radix sort. By expiration year the index is
+//* already in order, so its range is used as it is. Ties keep identifier order.
+int ordena_listado(const BancoSemillas *banco, const IndiceCaducidad *indice, const ListadoOrdenado *listado) {
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_ORDENA);
+
+    size_t n_palabras = (banco->n_semillas + 63) / 64;
+    uint64_t *mapa = NULL;
+    FiltroDonacion filtro = {0};
+    size_t n_candidatas;
+    int k_inicio = 0, k_fin = 0;
+
+    // Seeds of the listing, as a bitmap
+    if (listado->donadas) {
+        Agregados ag;
+        if (filtro_crea(&filtro, banco) == -1) return -1;
+
+        recorre_banco(banco, INFORME_DONACION, &filtro, &ag);
+        mapa = filtro.donadas;
+        n_candidatas = ag.contadorDonadas;
+    } else {
+        indice_rango(indice, listado->start_year, listado->end_year, &k_inicio, &k_fin);
+        n_candidatas = indice->semillas_hasta[k_fin] - indice->semillas_hasta[k_inicio];
+
+        mapa = calloc(n_palabras > 0 ? n_palabras : 1, sizeof(uint64_t));
+        if (mapa == NULL) return -1;
+
+        // Same as escribe_caducadas: the seeds of the range come from the index unless a delta file moved them
+        if (indice->ordenado) {
+            for (size_t j = indice->semillas_hasta[k_inicio]; j < indice->semillas_hasta[k_fin]; j++) {
+                uint32_t i = indice->indices[j];
+                mapa[i / 64] |= (uint64_t) 1 << (i % 64);
+            }
+        } else {
+            for (size_t i = 0; i < banco->n_semillas; i++) {
+                if (banco->vCategorias[i] != SLOT_VACIO && banco->vCaducidad[i] >= listado->start_year &&
+                    banco->vCaducidad[i] <= listado->end_year) {
+                    mapa[i / 64] |= (uint64_t) 1 << (i % 64);
+                }
+            }
+        }
+    }
+
+    uint64_t *pares = malloc((n_candidatas > 0 ? n_candidatas : 1) * sizeof(uint64_t));
+    uint64_t *ordenados = pares;
+    size_t n = 0, top = listado->top > 0 && listado->top < n_candidatas ? listado->top : n_candidatas;
+    int resultado = 0;
+
+    if (pares == NULL) {
+        resultado = -1;
+    } else if (!listado->donadas && listado->orden == ORDEN_CADUCIDAD && indice->ordenado) {
+        // The index range is already sorted by year and identifier
+        for (size_t j = indice->semillas_hasta[k_inicio]; j < indice->semillas_hasta[k_fin]; j++) pares[n++] = indice->indices[j];
+        for (size_t j = 0; j < n; j++) pares[j] |= (uint64_t) clave_orden(banco, pares[j], ORDEN_CADUCIDAD) << 32;
+    } else {
+        n = pares_de_bitmap(banco, mapa, n_palabras, listado->orden, pares);
+
+        if (top * FRACCION_MONTICULO <= n) {
+            top_k_pares(pares, n, top);
+        } else {
+            uint64_t *aux = malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+            ordenados = aux != NULL ? ordena_pares(pares, aux, n) : NULL;
+            if (ordenados == NULL) {
+                free(aux);
+                resultado = -1;
+            } else if (ordenados == pares) free(aux);
+            else free(pares);
+        }
+    }
+
+    if (listado->donadas) filtro_libera(&filtro);
+    else free(mapa);
+
+    Escritor file;
+
+    if (resultado == 0 && escritor_abre(&file, listado->ruta) == -1) resultado = -2;
+
+    if (resultado == 0) {
+        for (size_t j = 0; j < top; j++) {
+            size_t i = (uint32_t) ordenados[j];
+            if (listado->donadas) escribe_donada(banco, i, &file);
+            else escribe_caducada(banco, i, &file);
+        }
+
+        if (escritor_cierra(&file) == -1) resultado = -2;
+        else printf("Escritas %zu de %zu semillas %s por %s en %s\n", top, n_candidatas,
+                    listado->donadas ? "donadas" : "caducadas", orden_claves[listado->orden], listado->ruta);
+    }
+
+    free(ordenados != NULL ? ordenados : pares);
+
+    if (resultado == -1) fprintf(stderr, "Error: No hay memoria suficiente para ordenar el listado\n");
+    else if (resultado == -2) fprintf(stderr, "Error: No se pudo crear el archivo %s\n", listado->ruta);
+
+    tramo_cierra(&tramo, n_candidatas, top);
+    return resultado == 0 ? 0 : -1;
+}
+
+//* Builder of the categorical bitmaps, shared by the threads
+typedef struct {
+    const BancoSemillas *banco;
+    IndiceBitmaps *bitmaps;
+} ConstruccionBitmaps;
+
+//* Sets the bits of the seeds [inicio, fin) in the bitmap of each of their values
+static void marca_bitmaps(void *contexto, size_t inicio, size_t fin, int hilo) {
+    (void) hilo;
+    ConstruccionBitmaps *construccion = contexto;
+    const BancoSemillas *banco = construccion->banco;
+    IndiceBitmaps *bitmaps = construccion->bitmaps;
+
+    for (size_t i = inicio; i < fin; i++) {
+        if (banco->vCategorias[i] == SLOT_VACIO) continue; // No seed with this identifier
+
+        size_t w = i / 64;
+        uint64_t bit = (uint64_t) 1 << (i % 64);
+
+        bitmaps->vivas[w] |= bit;
+        uint16_t categorias = banco->vCategorias[i];
+
+        bitmaps->valor[CAMPO_RIESGO][CATEGORIA(categorias, RIESGO) - 1][w] |= bit;
+        bitmaps->valor[CAMPO_CRECIMIENTO][CATEGORIA(categorias, CRECIMIENTO) - 1][w] |= bit;
+        bitmaps->valor[CAMPO_REPRODUCCION][CATEGORIA(categorias, REPRODUCCION) - 1][w] |= bit;
+        bitmaps->valor[CAMPO_ADAPTACION][CATEGORIA(categorias, ADAPTACION) - 1][w] |= bit;
+        bitmaps->valor[CAMPO_CICLO][CATEGORIA(categorias, CICLO) - 1][w] |= bit;
+        bitmaps->valor[CAMPO_BIOMA][banco->vSeccion[i] % 10][w] |= bit;
+    }
+}
+
+//* Function to build one bitmap per value of the categorical fields of the bank
+//* Big banks are split among the threads; parts start at multiples of 64 seeds, so
+//* each thread only sets bits in its own words.
+int bitmaps_construye(IndiceBitmaps *bitmaps, const BancoSemillas *banco) {
+
+    *bitmaps = (IndiceBitmaps) {0};
+
+    size_t n_palabras = (banco->n_semillas + 63) / 64;
+    size_t n_mapas = 1; // vivas
+    for (int c = 0; c < N_CAMPOS; c++) n_mapas += valores_campo[c];
+
+    // All the bitmaps share one allocation
+    uint64_t *palabras = calloc(n_mapas * n_palabras + 1, sizeof(uint64_t));
+    if (palabras == NULL) return -1;
+
+    bitmaps->n_palabras = n_palabras;
+    bitmaps->vivas = palabras;
+
+    uint64_t *siguiente = palabras + n_palabras;
+    for (int c = 0; c < N_CAMPOS; c++) {
+        for (int v = 0; v < valores_campo[c]; v++) {
+            bitmaps->valor[c][v] = siguiente;
+            siguiente += n_palabras;
+        }
+    }
+
+    ConstruccionBitmaps construccion = {banco, bitmaps};
+    int hilos = hilos_para(banco->n_semillas);
+
+    if (hilos == 1) marca_bitmaps(&construccion, 0, banco->n_semillas, 0);
+    else ejecuta_en_paralelo(banco->n_semillas, hilos, marca_bitmaps, &construccion);
+
+    return 0;
+}
+
+//* Function to free the bitmaps of the categorical fields
+void bitmaps_libera(IndiceBitmaps *bitmaps) {
+    free(bitmaps->vivas);
+    *bitmaps = (IndiceBitmaps) {0};
+}
+
+//* Bitmaps a query reads, resolved once before walking the words
+typedef struct {
+    int n_campos;                                         // Fields with some accepted value
+    int n_mapas[N_CAMPOS];                                // Bitmaps ORed for each of those fields
+    const uint64_t *mapas[N_CAMPOS][MAX_VALORES_CAMPO];   // The bitmaps of the accepted values
+} PlanConsulta;
+
+static void prepara_consulta(const IndiceBitmaps *bitmaps, const Consulta *consulta, PlanConsulta *plan) {
+    plan->n_campos = 0;
+
+    for (int c = 0; c < N_CAMPOS; c++) {
+        if (consulta->valores[c] == 0) continue; // Any value
+
+        int n = 0;
+        for (int v = 0; v < valores_campo[c]; v++) {
+            if (consulta->valores[c] & (1u << v)) plan->mapas[plan->n_campos][n++] = bitmaps->valor[c][v];
+        }
+
+        plan->n_mapas[plan->n_campos++] = n;
+    }
+}
+
+//* Seeds of word w that match the query: OR of the accepted values of each field, AND of the fields
+static inline uint64_t consulta_palabra(const IndiceBitmaps *bitmaps, const PlanConsulta *plan, size_t w) {
+    uint64_t palabra = bitmaps->vivas[w];
+
+    for (int c = 0; c < plan->n_campos && palabra != 0; c++) {
+        uint64_t campo = 0;
+        for (int m = 0; m < plan->n_mapas[c]; m++) campo |= plan->mapas[c][m][w];
+        palabra &= campo;
+    }
+
+    return palabra;
+}
+
+//* Function to count the seeds that match a query, one popcount per word
+size_t consulta_cuenta(const IndiceBitmaps *bitmaps, const Consulta *consulta) {
+    PlanConsulta plan;
+    prepara_consulta(bitmaps, consulta, &plan);
+
+    size_t total = 0;
+    for (size_t w = 0; w < bitmaps->n_palabras; w++) {
+        total += __builtin_popcountll(consulta_palabra(bitmaps, &plan, w));
+    }
+
+    return total;
+}
+
+//* Function to list the identifiers of the seeds that match a query, in identifier order
+//* Stores at most max_ids of them in `ids` and returns how many seeds match in total.
+size_t consulta_ids(const IndiceBitmaps *bitmaps, const Consulta *consulta, uint32_t *ids, size_t max_ids) {
+    PlanConsulta plan;
+    prepara_consulta(bitmaps, consulta, &plan);
+
+    size_t total = 0;
+    for (size_t w = 0; w < bitmaps->n_palabras; w++) {
+        uint64_t palabra = consulta_palabra(bitmaps, &plan, w);
+
+        while (palabra != 0) {
+            if (total < max_ids) ids[total] = (uint32_t) (w * 64 + __builtin_ctzll(palabra) + 1);
+            total++;
+            palabra &= palabra - 1; // Clear the lowest set bit
+        }
+    }
+
+    return total;
+}
+
+//* Asks the user for the values accepted in every categorical field
+//* Each field takes a line with several values separated by spaces (ORed); 0 or an empty
+//* line accepts any value.
+void pide_consulta(Consulta *consulta) {
+
+    *consulta = (Consulta) {0};
+
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF); // Rest of the line of the menu option
+
+    for (int campo = 0; campo < N_CAMPOS; campo++) {
+        bool valida;
+
+        do {
+            printf("Valores de %s (1-%d separados por espacios, 0 = cualquiera): ", campo_names[campo], valores_campo[campo]);
+
+            char linea[256];
+            if (fgets(linea, sizeof(linea), stdin) == NULL) return; // No more input: any value
+
+            uint16_t valores = 0;
+            char *p = linea, *fin;
+            valida = true;
+
+            for (long v = strtol(p, &fin, 10); fin != p; v = strtol(p, &fin, 10)) {
+                p = fin;
+                if (v == 0) continue;
+                if (v < 0 || v > valores_campo[campo]) valida = false;
+                else valores |= 1u << (v - 1);
+            }
+
+            // Anything left that is not a number makes the line invalid
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+            if (*p != '\0') valida = false;
+
+            if (!valida) printf("Entrada invalida. Los valores deben ser numeros enteros entre 0 y %d.\n", valores_campo[campo]);
+            else consulta->valores[campo] = valores;
+        } while (!valida);
+    }
+}
+
+//* Asks the user for the name of a file (one word)
+void pide_fichero(char *ruta, size_t tam) {
+    char formato[32];
+    snprintf(formato, sizeof(formato), "%%%zus", tam - 1);
+
+    printf("Introduce el nombre del archivo: ");
+    if (scanf(formato, ruta) != 1) ruta[0] = '\0';
+}
+
+//* Function to run an ad-hoc query over the categorical fields
+//* Counts come from popcounts over the bitmaps; only the matching seeds are read to write the file
+int consulta_categorias(const BancoSemillas *banco, const IndiceBitmaps *bitmaps, const Consulta *consulta, const char *ruta) {
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_CONSULTA);
+
+    Escritor file;
+
+    if (escritor_abre(&file, ruta) == -1) return -1;
+
+    size_t total = consulta_cuenta(bitmaps, consulta);
+
+    uint32_t *ids = malloc((total > 0 ? total : 1) * sizeof(uint32_t));
+    if (ids == NULL) {
+        escritor_cierra(&file);
+        return -1;
+    }
+
+    consulta_ids(bitmaps, consulta, ids, total);
+
+    for (size_t j = 0; j < total; j++) {
+        size_t i = ids[j] - 1;
+
+        ESCRIBE(&file, "Semilla ");
+        escritor_entero(&file, ids[j]);
+        ESCRIBE(&file, ": seccion ");
+        escritor_entero(&file, banco->vSeccion[i]);
+        ESCRIBE(&file, " caducidad ");
+        escritor_entero(&file, banco->vCaducidad[i]);
+        ESCRIBE(&file, " (muestra ");
+        escritor_entero(&file, banco->vNumSemillas[i]);
+        ESCRIBE(&file, ")\n");
+    }
+
+    free(ids);
+
+    printf("Semillas que cumplen la consulta: %zu (%.1f%% del total)\n",
+           total, banco->n_vivas > 0 ? total / (float) banco->n_vivas * 100 : 0.0f);
+
+    int resultado = escritor_cierra(&file);
+
+    tramo_cierra(&tramo, banco->n_semillas, total);
+    return resultado;
+}
+
+//* Cell of the cube of the seed with index i
+static inline size_t cubo_celda(const BancoSemillas *banco, size_t i) {
+    uint16_t c = banco->vCategorias[i];
+
+    return (((((size_t) (CATEGORIA(c, RIESGO) - 1) * PLANTA_TREPADORA + CATEGORIA(c, CRECIMIENTO) - 1) * SIN_FLORES +
+              CATEGORIA(c, REPRODUCCION) - 1) * OTROS + CATEGORIA(c, ADAPTACION) - 1) * PERENNES +
+              CATEGORIA(c, CICLO) - 1) * N_BIOMAS + banco->vSeccion[i] % 10;
+}
+
+//* Function to build the cube of the bank with one pass
+//* Each seed is added to the slice of its expiration year, then the slices are accumulated
+int cubo_construye(Cubo *cubo, const BancoSemillas *banco) {
+
+    *cubo = (Cubo) {0};
+
+    int anyo_min = UINT16_MAX, anyo_max = -1;
+
+    for (size_t i = 0; i < banco->n_semillas; i++) {
+        if (banco->vCategorias[i] == SLOT_VACIO) continue;
+        if (banco->vCaducidad[i] < anyo_min) anyo_min = banco->vCaducidad[i];
+        if (banco->vCaducidad[i] > anyo_max) anyo_max = banco->vCaducidad[i];
+    }
+
+    cubo->por_anyo = anyo_max - anyo_min + 1 <= MAX_ANYOS_CUBO;
+    cubo->anyo_min = cubo->por_anyo && anyo_max >= 0 ? anyo_min : 0;
+    cubo->n_anyos = anyo_max < 0 ? 0 : cubo->por_anyo ? anyo_max - anyo_min + 1 : 1;
+
+    size_t n_celdas = (size_t) (cubo->n_anyos + 1) * CUBO_CELDAS;
+    cubo->semillas = calloc(n_celdas, sizeof(int32_t));
+    cubo->muestras = calloc(n_celdas, sizeof(int64_t));
+
+    if (cubo->semillas == NULL || cubo->muestras == NULL) {
+        cubo_libera(cubo);
+        return -1;
+    }
+
+    for (size_t i = 0; i < banco->n_semillas; i++) {
+        if (banco->vCategorias[i] == SLOT_VACIO) continue;
+
+        size_t k = cubo->por_anyo ? (size_t) (banco->vCaducidad[i] - cubo->anyo_min + 1) : 1;
+        size_t celda = k * CUBO_CELDAS + cubo_celda(banco, i);
+
+        cubo->semillas[celda]++;
+        cubo->muestras[celda] += banco->vNumSemillas[i];
+    }
+
+    // Slice k adds the seeds of every year before anyo_min + k
+    for (size_t c = 2 * CUBO_CELDAS; c < n_celdas; c++) {
+        cubo->semillas[c] += cubo->semillas[c - CUBO_CELDAS];
+        cubo->muestras[c] += cubo->muestras[c - CUBO_CELDAS];
+    }
+
+    return 0;
+}
+
+//* Function to free the slices of the cube
+void cubo_libera(Cubo *cubo) {
+    free(cubo->semillas);
+    free(cubo->muestras);
+    *cubo = (Cubo) {0};
+}
+
+//* Function to add up the cells of the cube that match `consulta` (slice) for the seeds expiring
+//* in [anyo_inicio, anyo_fin], grouped by the values of `campo` (roll-up of the other fields;
+//* campo -1 adds everything into [0]). Every query reads each cell of two slices once.
+//* Returns -1 if the cube only has totals and the range of years does not cover every year
+int cubo_agrupa(const Cubo *cubo, const Consulta *consulta, int campo, int anyo_inicio, int anyo_fin,
+                long long semillas[MAX_VALORES_CAMPO], long long muestras[MAX_VALORES_CAMPO]) {
+
+    memset(semillas, 0, MAX_VALORES_CAMPO * sizeof(long long));
+    memset(muestras, 0, MAX_VALORES_CAMPO * sizeof(long long));
+
+    // Slices whose difference holds the range of years
+    int k_inicio = anyo_inicio - cubo->anyo_min, k_fin = anyo_fin - cubo->anyo_min + 1;
+
+    if (!cubo->por_anyo) {
+        if (anyo_inicio > 0 || anyo_fin < UINT16_MAX) return -1;
+        k_inicio = 0;
+        k_fin = cubo->n_anyos;
+    }
+
+    if (k_inicio < 0) k_inicio = 0;
+    if (k_fin > cubo->n_anyos) k_fin = cubo->n_anyos;
+    if (k_fin <= k_inicio) return 0;
+
+    const int32_t *semillas_desde = cubo->semillas + (size_t) k_inicio * CUBO_CELDAS;
+    const int32_t *semillas_hasta = cubo->semillas + (size_t) k_fin * CUBO_CELDAS;
+    const int64_t *muestras_desde = cubo->muestras + (size_t) k_inicio * CUBO_CELDAS;
+    const int64_t *muestras_hasta = cubo->muestras + (size_t) k_fin * CUBO_CELDAS;
+
+    bool acepta[N_CAMPOS][MAX_VALORES_CAMPO];
+    for (int f = 0; f < N_CAMPOS; f++) {
+        for (int v = 0; v < valores_campo[f]; v++) acepta[f][v] = consulta->valores[f] == 0 || (consulta->valores[f] >> v & 1);
+    }
+
+    int valor[N_CAMPOS] = {0}; // Values (0-based) of the current cell
+
+    for (size_t c = 0; c < CUBO_CELDAS; c++) {
+        bool cumple = true;
+        for (int f = 0; f < N_CAMPOS; f++) cumple &= acepta[f][valor[f]];
+
+        if (cumple) {
+            int g = campo >= 0 ? valor[campo] : 0;
+            semillas[g] += semillas_hasta[c] - semillas_desde[c];
+            muestras[g] += muestras_hasta[c] - muestras_desde[c];
+        }
+
+        // Next cell: the last field changes fastest
+        for (int f = N_CAMPOS - 1; f >= 0 && ++valor[f] == valores_campo[f]; f--) valor[f] = 0;
+    }
+
+    return 0;
+}
+
+//* Function to fill the risk and biome counts of the reports from the cube
+void cubo_agregados(const Cubo *cubo, Agregados *ag) {
+    long long semillas[MAX_VALORES_CAMPO], muestras[MAX_VALORES_CAMPO];
+    Consulta todas = {0}, extremo = {0};
+    extremo.valores[CAMPO_RIESGO] = 1u << (RIESGO_EXTREMO - 1);
+
+    // Every year: the cube always has the totals
+    cubo_agrupa(cubo, &todas, CAMPO_CRECIMIENTO, 0, UINT16_MAX, semillas, muestras);
+    for (int t = 0; t < NUM_OF_TYPES_OF_SEEDS; t++) ag->count_by_type_total[t] = semillas[t];
+
+    cubo_agrupa(cubo, &extremo, CAMPO_CRECIMIENTO, 0, UINT16_MAX, semillas, muestras);
+    ag->count_total_riesgo_extremo = 0;
+    for (int t = 0; t < NUM_OF_TYPES_OF_SEEDS; t++) {
+        ag->count_by_type[t] = semillas[t];
+        ag->count_total_riesgo_extremo += semillas[t];
+    }
+
+    cubo_agrupa(cubo, &todas, CAMPO_BIOMA, 0, UINT16_MAX, semillas, muestras);
+    for (int b = 0; b < N_BIOMAS; b++) ag->biomas[b] = semillas[b];
+}
+
+//* Function to print the seeds and samples of a slice of the cube (by the values of `campo`, or -1 for the total)
+//* Returns -1 if the cube cannot answer the range of years
+int cubo_informe(const BancoSemillas *banco, const Cubo *cubo, const Consulta *consulta, int campo, int anyo_inicio, int anyo_fin) {
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_CUBO);
+
+    long long semillas[MAX_VALORES_CAMPO], muestras[MAX_VALORES_CAMPO];
+
+    if (cubo_agrupa(cubo, consulta, campo, anyo_inicio, anyo_fin, semillas, muestras) == -1) {
+        fprintf(stderr, "Error: El banco abarca mas de %d anyos de caducidad; el cubo solo guarda los totales\n", MAX_ANYOS_CUBO);
+        return -1;
+    }
+
+    long long total = 0;
+    for (int v = 0; v < MAX_VALORES_CAMPO; v++) total += semillas[v];
+
+    float n_vivas = banco->n_vivas > 0 ? banco->n_vivas : 1;
+
+    if (campo < 0) {
+        printf("Semillas que cumplen la consulta: %lld (%.1f%% del total), %lld muestras\n", total, total / n_vivas * 100, muestras[0]);
+    } else {
+        printf("Semillas que cumplen la consulta por %s: %lld (%.1f%% del total)\n", campo_names[campo], total, total / n_vivas * 100);
+
+        for (int v = 0; v < valores_campo[campo]; v++) {
+            printf("    %s: %lld semillas (%.1f%% del total), %lld muestras\n",
+                   valor_names[campo][v], semillas[v], semillas[v] / n_vivas * 100, muestras[v]);
+        }
+    }
+
+    tramo_cierra(&tramo, CUBO_CELDAS, total);
+    return 0;
+}
+
+//* One kernel per count table: the keys and the filter are macros and the counters a local
+//* array of constant size, so each table gets its own loop with no dispatch per seed
+#define DEFINE_CUENTA_TABLA(nombre, fila, columna, filtro, titulo)                                   \
+    _Static_assert(CARD_##fila * CARD_##columna <= MAX_CELDAS_TABLA, "Tabla " #nombre " demasiado grande"); \
+    static void cuenta_##nombre(const BancoSemillas *banco, size_t inicio, size_t fin, int *total) { \
+        int cuenta[CARD_##fila][CARD_##columna] = {{0}};                                           \
+        const uint16_t *vCategorias = banco->vCategorias;                                          \
+                                                                                                   \
+        for (size_t i = inicio; i < fin; i++) {                                                    \
+            if (vCategorias[i] == SLOT_VACIO || !(FILTRO_##filtro(banco, i))) continue;            \
+            cuenta[CLAVE_##fila(banco, i)][CLAVE_##columna(banco, i)]++;                           \
+        }                                                                                          \
+                                                                                                   \
+        for (int f = 0; f < CARD_##fila; f++) {                                                    \
+            for (int c = 0; c < CARD_##columna; c++) total[f * CARD_##columna + c] += cuenta[f][c]; \
+        }                                                                                          \
+    }
+
+TABLAS_CONTEO(DEFINE_CUENTA_TABLA)
+
+#define REGISTRA_TABLA(nombre, fila, columna, filtro, titulo) \
+    {#nombre, titulo, CARD_##fila, CARD_##columna, NOMBRES_##fila, NOMBRES_##columna, cuenta_##nombre},
+
+//* Every count table of TABLAS_CONTEO, in the same order
+const TablaConteo tablas_conteo[] = {TABLAS_CONTEO(REGISTRA_TABLA)};
+
+#define N_TABLAS_CONTEO ((int) (sizeof(tablas_conteo) / sizeof(tablas_conteo[0])))
+
+//* Function to find a count table by its name
+const TablaConteo *busca_tabla(const char *nombre) {
+    for (int t = 0; t < N_TABLAS_CONTEO; t++) {
+        if (strcmp(tablas_conteo[t].nombre, nombre) == 0) return &tablas_conteo[t];
+    }
+    return NULL;
+}
+
+//* Function to ask the user for one of the count tables (NULL if the answer is not valid)
+const TablaConteo *pide_tabla(void) {
+    for (int t = 0; t < N_TABLAS_CONTEO; t++) printf("%d. %s.\n", t + 1, tablas_conteo[t].titulo);
+
+    int opcion;
+    printf("Elige una tabla (1-%d): ", N_TABLAS_CONTEO);
+
+    if (scanf("%d", &opcion) != 1 || opcion < 1 || opcion > N_TABLAS_CONTEO) {
+        printf("Entrada invalida. La tabla debe ser un numero entero entre 1 y %d.\n", N_TABLAS_CONTEO);
+        int c;
+        while ((c = getchar()) != '\n' && c != EOF); // Clear invalid input from the buffer
+        return NULL;
+    }
+
+    return &tablas_conteo[opcion - 1];
+}
+
+//* State of one thread of tabla_cuenta, aligned to a cache line like ParteRecorrido
+typedef struct {
+    _Alignas(64) int cuenta[MAX_CELDAS_TABLA];
+} ParteTabla;
+
+typedef struct {
+    const BancoSemillas *banco;
+    const TablaConteo *tabla;
+    ParteTabla *partes;
+} RecorridoTabla;
+
+static void tabla_parte(void *contexto, size_t inicio, size_t fin, int hilo) {
+    RecorridoTabla *recorrido = contexto;
+    recorrido->tabla->cuenta(recorrido->banco, inicio, fin, recorrido->partes[hilo].cuenta);
+}
+
+//* Function to count the seeds of a count table (cell f * columnas + c is row value f, column value c)
+//* Big banks are split among num_hilos threads and the parts are added in order
+void tabla_cuenta(const BancoSemillas *banco, const TablaConteo *tabla, int cuenta[MAX_CELDAS_TABLA]) {
+    int hilos = hilos_para(banco->n_semillas);
+
+    ParteTabla partes[hilos];
+    memset(partes, 0, sizeof(partes));
+
+    RecorridoTabla recorrido = {banco, tabla, partes};
+
+    if (hilos == 1) tabla_parte(&recorrido, 0, banco->n_semillas, 0);
+    else ejecuta_en_paralelo(banco->n_semillas, hilos, tabla_parte, &recorrido);
+
+    memset(cuenta, 0, MAX_CELDAS_TABLA * sizeof(int));
+    for (int h = 0; h < hilos; h++) {
+        for (int k = 0; k < tabla->filas * tabla->columnas; k++) cuenta[k] += partes[h].cuenta[k];
+    }
+}
+
+//* Function to print a count table: one line per value of the row key
+void tabla_conteo(const BancoSemillas *banco, const TablaConteo *tabla) {
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_TABLA);
+
+    int cuenta[MAX_CELDAS_TABLA];
+    tabla_cuenta(banco, tabla, cuenta);
+
+    int total = 0;
+    for (int k = 0; k < tabla->filas * tabla->columnas; k++) total += cuenta[k];
+
+    printf("%s (%d especies):\n", tabla->titulo, total);
+
+    for (int f = 0; f < tabla->filas; f++) {
+        printf("    %s:", tabla->nombres_fila[f]);
+
+        for (int c = 0; c < tabla->columnas; c++) {
+            int n = cuenta[f * tabla->columnas + c];
+            float porcentaje = total > 0 ? n / (float) total * 100 : 0.0f;
+
+            if (tabla->nombres_columna == NULL) printf(" %d (%.1f%%)", n, porcentaje);
+            else printf("%s %s %d (%.1f%%)", c == 0 ? "" : ",", tabla->nombres_columna[c], n, porcentaje);
+        }
+        printf("\n");
+    }
+
+    tramo_cierra(&tramo, banco->n_semillas, total);
+}
+
+//* Function to create an empty bank with room for N_SEMILLAS seeds
+int banco_inicializa(BancoSemillas *banco) {
+    *banco = (BancoSemillas) {0};
+    return banco_reserva(banco, N_SEMILLAS);
+}
+
+//* Grows one array of the bank to nueva_capacidad elements, filling the new ones with 0
+static int crece_columna(void **columna, size_t tam_elemento, size_t capacidad, size_t nueva_capacidad) {
+    void *nueva = realloc(*columna, nueva_capacidad * tam_elemento);
+    if (nueva == NULL) return -1;
+
+    memset((char *) nueva + capacidad * tam_elemento, 0, (nueva_capacidad - capacidad) * tam_elemento);
+    *columna = nueva;
+    return 0;
+}
+
+//* Size of the elements of each array of the bank, in the order of the struct
+static const size_t tam_columnas[N_COLUMNAS] = {
+    sizeof(uint16_t), sizeof(uint16_t), sizeof(int32_t), sizeof(uint8_t), sizeof(uint16_t)
+};
+
+//* Fills `columnas` with the addresses of the array pointers of the bank, in the order of the struct
+static void banco_columnas(BancoSemillas *banco, void **columnas[N_COLUMNAS]) {
+    columnas[0] = (void **) &banco->vAnyo;
+    columnas[1] = (void **) &banco->vCaducidad;
+    columnas[2] = (void **) &banco->vNumSemillas;
+    columnas[3] = (void **) &banco->vSeccion;
+    columnas[4] = (void **) &banco->vCategorias;
+}
+
+//* Copies the arrays of a mapped snapshot to the heap, with room for nueva_capacidad seeds
+static int banco_desmapea(BancoSemillas *banco, size_t nueva_capacidad) {
+    void **columnas[N_COLUMNAS];
+    void *copias[N_COLUMNAS] = {NULL};
+    banco_columnas(banco, columnas);
+
+    for (int c = 0; c < N_COLUMNAS; c++) {
+        copias[c] = calloc(nueva_capacidad > 0 ? nueva_capacidad : 1, tam_columnas[c]);
+
+        if (copias[c] == NULL) {
+            while (--c >= 0) free(copias[c]);
+            return -1;
+        }
+
+        memcpy(copias[c], *columnas[c], banco->n_semillas * tam_columnas[c]);
+    }
+
+    munmap(banco->mapa, banco->tam_mapa);
+    banco->mapa = NULL;
+    banco->tam_mapa = 0;
+
+    for (int c = 0; c < N_COLUMNAS; c++) *columnas[c] = copias[c];
+
+    banco->capacidad = nueva_capacidad;
+    return 0;
+}
+
+//* Function to make sure the bank has room for at least n_slots seeds
+//* The capacity at least doubles every time it grows, so loading stays linear
+int banco_reserva(BancoSemillas *banco, size_t n_slots) {
+    if (n_slots <= banco->capacidad) return 0;
+
+    size_t nueva_capacidad = banco->capacidad * 2;
+    if (nueva_capacidad < n_slots) nueva_capacidad = n_slots;
+
+    // The arrays of a mapped snapshot cannot be realloc'd
+    if (banco->mapa != NULL) return banco_desmapea(banco, nueva_capacidad);
+
+    void **columnas[N_COLUMNAS];
+    banco_columnas(banco, columnas);
+
+    for (int c = 0; c < N_COLUMNAS; c++) {
+        // On failure the arrays already grown are still valid, just bigger than capacidad
+        if (crece_columna(columnas[c], tam_columnas[c], banco->capacidad, nueva_capacidad) == -1) return -1;
+    }
+
+    banco->capacidad = nueva_capacidad;
+    return 0;
+}
+
+//* Function to free all the arrays of the bank
+void banco_libera(BancoSemillas *banco) {
+    if (banco->mapa != NULL) {
+        munmap(banco->mapa, banco->tam_mapa);
+    } else {
+        void **columnas[N_COLUMNAS];
+        banco_columnas(banco, columnas);
+
+        for (int c = 0; c < N_COLUMNAS; c++) free(*columnas[c]);
+    }
+
+    *banco = (BancoSemillas) {0};
+}
+
+//* Parses one unsigned decimal number starting at *p, skipping any leading whitespace
+//* A number beyond INT32_MAX is consumed whole and stored as -1, like the delta parser does,
+//* so campos_validos rejects its line instead of keeping a wrapped value.
+//* Returns false if there is no number before the end of the buffer
+static bool lee_entero(const char **p, const char *fin, int *valor) {
+    const char *c = *p;
+
+    // Skip separators (spaces, tabs and line breaks, including \r from Windows files)
+    while (c < fin && (*c == ' ' || *c == '\n' || *c == '\t' || *c == '\r')) c++;
+
+    if (c == fin || (unsigned) (*c - '0') > 9) {
+        *p = c;
+        return false;
+    }
+
+    int n = 0;
+    do {
+        int digito = *c - '0';
+        if (n != -1) n = n <= (INT32_MAX - digito) / 10 ? n * 10 + digito : -1;
+        c++;
+    } while (c < fin && (unsigned) (*c - '0') <= 9);
+
+    *valor = n;
+    *p = c;
+    return true;
+}
+
+//* Checks that the 10 fields of a line of semillas.txt fit their arrays
+//* (the reports also use the types as array indexes; -1 marks a number too big to read)
+static bool campos_validos(const int campos[10]) {
+    return campos[0] >= 1 && campos[0] <= MAX_IDENTIFICADOR && campos[1] >= 0 && campos[1] <= UINT16_MAX && campos[2] >= 0 && campos[2] <= UINT16_MAX &&
+           campos[3] >= 0 &&
+           campos[4] >= 1 && campos[4] <= N_SECCIONES &&
+           campos[5] >= RIESGO_EXTREMO && campos[5] <= SIN_RIESGO &&
+           campos[6] >= ARBOL && campos[6] <= PLANTA_TREPADORA &&
+           campos[7] >= CON_FLORES && campos[7] <= SIN_FLORES &&
+           campos[8] >= DESERTICAS && campos[8] <= OTROS &&
+           campos[9] >= ANUALES && campos[9] <= PERENNES;
+}
+
+//* Stores the fields of a line of semillas.txt in the slot `index` of the bank
+static inline void coloca_semilla(BancoSemillas *banco, size_t index, const int campos[10]) {
+    banco->vAnyo[index] = campos[1];
+    banco->vCaducidad[index] = campos[2];
+    banco->vNumSemillas[index] = campos[3];
+    banco->vSeccion[index] = campos[4];
+    banco->vCategorias[index] = EMPAQUETA(campos[5], campos[6], campos[7], campos[8], campos[9]);
+}
+
+//* Leaves the slot `index` of the bank empty (every field to 0, as in a slot never used)
+static inline void vacia_semilla(BancoSemillas *banco, size_t index) {
+    int campos[10] = {0};
+    coloca_semilla(banco, index, campos); // All five categories at 0 pack to SLOT_VACIO
+}
+
+//* Stores one parsed line in the bank, growing it if the identifier is beyond its capacity
+//* A repeated identifier keeps its last line; *duplicadas counts the repetitions
+static int coloca_fila(BancoSemillas *banco, const int campos[10], size_t *duplicadas) {
+    //the index of each type of seed is its identifier - 1
+    size_t index = (size_t) campos[0] - 1;
+
+    if (index >= banco->capacidad && banco_reserva(banco, index + 1) == -1) return -1;
+
+    if (banco->vCategorias[index] == SLOT_VACIO) banco->n_vivas++;
+    else (*duplicadas)++;
+    if (index >= banco->n_semillas) banco->n_semillas = index + 1;
+
+    coloca_semilla(banco, index, campos);
+    return 0;
+}
+
+//* Parses the lines of [p, fin) one after another into the bank
+//* Stops at the first incomplete line, like the old fscanf loop
+static int parsea_serie(BancoSemillas *banco, const char *p, const char *fin, size_t *filas, size_t *duplicadas) {
+    int campos[10]; // identificador, anyo, caducidad, numSemillas, seccion, riesgo, tipoCrecimiento, tipoReproduccion, tipoAdaptacion, tipoCiclo
+
+    while (true) {
+        int leidos = 0;
+        while (leidos < 10 && lee_entero(&p, fin, &campos[leidos])) leidos++;
+        if (leidos < 10) return 0;
+
+        if (!campos_validos(campos)) return -2;
+        if (coloca_fila(banco, campos, duplicadas) == -1) return -1;
+
+        (*filas)++;
+    }
+}
+
+// Related to the parallel parser
+#define PARTE_COMPLETA 0      // The part was parsed to its end
+#define PARTE_INVALIDA -2     // A line has values out of range
+#define PARTE_SIN_MEMORIA -1  // The list of lines beyond the capacity could not grow
+#define PARTE_DETENIDA 1      // An incomplete line before the end of the part
+#define PARTE_DUPLICADA 2     // An identifier already placed by this or another part
+
+//* State of one thread of the parallel parser, aligned to a cache line like ParteRecorrido
+//* Lines whose identifier is beyond the reserved slots are not placed by the thread: their
+//* start is kept in `desbordadas` and they are placed afterwards, in the order of the file.
+typedef struct {
+    _Alignas(64) size_t filas;
+    size_t vivas;
+    size_t n_semillas;
+    int estado;
+    const char **desbordadas;
+    size_t n_desbordadas, cap_desbordadas;
+} ParteLectura;
+
+typedef struct {
+    BancoSemillas *banco;
+    const char *datos;
+    size_t tam;
+    ParteLectura *partes;
+} Lectura;
+
+//* First line start at or after the byte `pos` of the file
+static const char *inicio_de_linea(const char *datos, size_t tam, size_t pos) {
+    if (pos == 0) return datos;
+    if (pos >= tam) return datos + tam;
+
+    const char *salto = memchr(datos + pos - 1, '\n', tam - (pos - 1));
+    return salto != NULL ? salto + 1 : datos + tam;
+}
+
+//* Parses the lines that start in the bytes [inicio, fin) of the file straight into their slots
+//* Both ends are moved to the next line start, so every line belongs to exactly one part.
+//* Each slot is claimed by swapping in its risk (never SLOT_VACIO for a valid line): a part
+//* that finds the slot taken has met a repeated identifier and stops.
+static void lee_parte(void *contexto, size_t inicio, size_t fin, int hilo) {
+    Lectura *lectura = contexto;
+    BancoSemillas *banco = lectura->banco;
+    ParteLectura *parte = &lectura->partes[hilo];
+
+    const char *p = inicio_de_linea(lectura->datos, lectura->tam, inicio);
+    const char *limite = inicio_de_linea(lectura->datos, lectura->tam, fin);
+
+    int campos[10];
+
+    while (true) {
+        const char *linea = p;
+
+        int leidos = 0;
+        while (leidos < 10 && lee_entero(&p, limite, &campos[leidos])) leidos++;
+        if (leidos < 10) {
+            if (leidos > 0 || p != limite) parte->estado = PARTE_DETENIDA;
+            return;
+        }
+
+        if (!campos_validos(campos)) {
+            parte->estado = PARTE_INVALIDA;
+            return;
+        }
+
+        parte->filas++;
+        size_t index = (size_t) campos[0] - 1;
+
+        if (index >= banco->capacidad) {
+            if (parte->n_desbordadas == parte->cap_desbordadas) {
+                size_t cap = parte->cap_desbordadas > 0 ? parte->cap_desbordadas * 2 : 64;
+                const char **nuevas = realloc(parte->desbordadas, cap * sizeof(*nuevas));
+                if (nuevas == NULL) {
+                    parte->estado = PARTE_SIN_MEMORIA;
+                    return;
+                }
+                parte->desbordadas = nuevas;
+                parte->cap_desbordadas = cap;
+            }
+            parte->desbordadas[parte->n_desbordadas++] = linea;
+            continue;
+        }
+
+        uint16_t categorias = EMPAQUETA(campos[5], campos[6], campos[7], campos[8], campos[9]);
+
+        if (__atomic_exchange_n(&banco->vCategorias[index], categorias, __ATOMIC_RELAXED) != SLOT_VACIO) {
+            parte->estado = PARTE_DUPLICADA;
+            return;
+        }
+
+        // Every field but the categories, which are already in place
+        banco->vAnyo[index] = campos[1];
+        banco->vCaducidad[index] = campos[2];
+        banco->vNumSemillas[index] = campos[3];
+        banco->vSeccion[index] = campos[4];
+
+        parte->vivas++;
+        if (index >= parte->n_semillas) parte->n_semillas = index + 1;
+    }
+}
+
+//* Parses the whole file on `hilos` threads and merges the parts in order
+//* Returns 1 if some part met a repeated identifier, an incomplete line or a value out of range:
+//* which line wins or where the load stops then depends on the order of the file, so the caller
+//* starts again with the serial parser, which gives the exact result and error.
+static int parsea_en_paralelo(BancoSemillas *banco, const char *datos, size_t tam, int hilos,
+                              size_t *filas, size_t *duplicadas) {
+    ParteLectura partes[hilos];
+    memset(partes, 0, sizeof(partes));
+
+    Lectura lectura = {banco, datos, tam, partes};
+    ejecuta_en_paralelo(tam, hilos, lee_parte, &lectura);
+
+    int resultado = 0;
+
+    for (int h = 0; h < hilos && resultado == 0; h++) {
+        if (partes[h].estado == PARTE_SIN_MEMORIA) resultado = -1;
+        else if (partes[h].estado != PARTE_COMPLETA) resultado = 1;
+    }
+
+    if (resultado == 0) {
+        for (int h = 0; h < hilos; h++) {
+            *filas += partes[h].filas;
+            banco->n_vivas += partes[h].vivas;
+            if (partes[h].n_semillas > banco->n_semillas) banco->n_semillas = partes[h].n_semillas;
+        }
+
+        // The lines beyond the capacity go last, in the order of the file, so the last one wins
+        for (int h = 0; h < hilos && resultado == 0; h++) {
+            for (size_t d = 0; d < partes[h].n_desbordadas; d++) {
+                const char *p = partes[h].desbordadas[d];
+                int campos[10];
+                for (int c = 0; c < 10; c++) lee_entero(&p, datos + tam, &campos[c]);
+
+                if (coloca_fila(banco, campos, duplicadas) == -1) {
+                    resultado = -1;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int h = 0; h < hilos; h++) free(partes[h].desbordadas);
+
+    return resultado;
+}
+
+//* Function to read data from the file `ruta` (semillas.txt in the menu)
+//* The file is memory-mapped and parsed in place, without going through stdio. Big files are
+//* split at line breaks among num_hilos threads that parse straight into the slots.
+//* Returns -1 if the file cannot be read and -2 if a line has values out of range
+int lee_datos(BancoSemillas *banco, const char *ruta){
+    struct timespec t_inicio, t_fin;
+    clock_gettime(CLOCK_MONOTONIC, &t_inicio);
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_LEE_DATOS);
+
+    int fd = open(ruta, O_RDONLY);
+
+    // Check if the file was successfully opened
+    if(fd == -1) {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    // An empty file has no seeds (mmap does not accept a length of 0)
+    if (info.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    const char *datos = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid after closing the descriptor
+
+    if (datos == MAP_FAILED) {
+        return -1;
+    }
+
+    madvise((void *) datos, info.st_size, MADV_SEQUENTIAL);
+
+    // Every line takes at least MIN_BYTES_POR_LINEA bytes, so this reserves enough slots for a dense file at once
+    size_t max_filas = info.st_size / MIN_BYTES_POR_LINEA;
+    if (banco_reserva(banco, max_filas + 1) == -1) {
+        munmap((void *) datos, info.st_size);
+        return -1;
+    }
+
+    size_t filas = 0, duplicadas = 0;
+    int hilos = hilos_para(max_filas);
+    int resultado = 1;
+
+    if (hilos > 1) {
+        resultado = parsea_en_paralelo(banco, datos, info.st_size, hilos, &filas, &duplicadas);
+
+        if (resultado == 1) {
+            // Start again from an empty bank
+            void **columnas[N_COLUMNAS];
+            banco_columnas(banco, columnas);
+            for (int c = 0; c < N_COLUMNAS; c++) memset(*columnas[c], 0, banco->capacidad * tam_columnas[c]);
+
+            banco->n_semillas = banco->n_vivas = 0;
+            filas = duplicadas = 0;
+        }
+    }
+
+    if (resultado == 1) resultado = parsea_serie(banco, datos, datos + info.st_size, &filas, &duplicadas);
+
+    munmap((void *) datos, info.st_size);
+
+    if (resultado != 0) return resultado;
+
+    clock_gettime(CLOCK_MONOTONIC, &t_fin);
+    double segundos = (t_fin.tv_sec - t_inicio.tv_sec) + (t_fin.tv_nsec - t_inicio.tv_nsec) / 1e9;
+
+    // Load statistics go to stderr so they don't mix with the menu output
+    fprintf(stderr, "Cargadas %zu semillas en %.3f ms (%.0f filas/s, %d hilos)\n",
+            filas, segundos * 1000, segundos > 0 ? filas / segundos : 0.0, hilos);
+
+    if (duplicadas > 0) {
+        fprintf(stderr, "Aviso: %zu identificadores repetidos en %s (se conserva su ultima linea)\n", duplicadas, ruta);
+    }
+
+    tramo_cierra(&tramo, filas, banco->n_vivas);
+    return 0;     // Return success
+}
+
+
+//* Function to fill the bank, from the binary snapshot when it is up to date
+//* A semillas.txt with the size and modification time recorded in semillas.bin is not read at
+//* all. Otherwise its checksum decides, so a copy or a touch of the same text still uses the
+//* snapshot (rewritten with the new time). If semillas.bin is missing or was written from another
+//* semillas.txt, the text is parsed and a new snapshot is written for the next start.
+//* Returns the same codes as lee_datos.
+int carga_banco(BancoSemillas *banco) {
+    struct stat origen;
+    uint64_t tam_origen, hash_origen;
+
+    if (stat("semillas.txt", &origen) == -1) return -1;
+
+    if (lee_snapshot(banco, FICHERO_SNAPSHOT, &origen, NULL) == 0) return 0;
+
+    if (huella_fichero("semillas.txt", &tam_origen, &hash_origen) == -1) return -1;
+
+    if (lee_snapshot(banco, FICHERO_SNAPSHOT, &origen, &hash_origen) == 0) {
+        escribe_snapshot(banco, FICHERO_SNAPSHOT, &origen, hash_origen); // Best effort: only saves the checksum next time
+        return 0;
+    }
+
+    int resultado = lee_datos(banco, "semillas.txt");
+    if (resultado != 0) return resultado;
+
+    if (escribe_snapshot(banco, FICHERO_SNAPSHOT, &origen, hash_origen) == -1) {
+        fprintf(stderr, "Aviso: No se pudo escribir el archivo %s\n", FICHERO_SNAPSHOT);
+    }
+
+    return 0;
+}
+
+//* Function to compute the size and a 64-bit FNV-1a checksum of a file
+//* The checksum takes 8 bytes per step, so it runs at memory speed instead of parse speed.
+int huella_fichero(const char *ruta, uint64_t *tam, uint64_t *hash) {
+    int fd = open(ruta, O_RDONLY);
+    if (fd == -1) return -1;
+
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    *tam = info.st_size;
+    *hash = 0xcbf29ce484222325ULL; // FNV offset basis
+
+    if (info.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    const unsigned char *datos = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (datos == MAP_FAILED) return -1;
+
+    madvise((void *) datos, info.st_size, MADV_SEQUENTIAL);
+
+    size_t n = info.st_size, i = 0;
+    uint64_t h = *hash;
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t palabra;
+        memcpy(&palabra, datos + i, 8);
+        h = (h ^ palabra) * 0x100000001b3ULL; // FNV prime
+    }
+    for (; i < n; i++) h = (h ^ datos[i]) * 0x100000001b3ULL;
+
+    munmap((void *) datos, info.st_size);
+    *hash = h;
+    return 0;
+}
+
+//* Function to write the bank to a binary snapshot
+//* The file is written under a temporary name and renamed, so a crash never leaves half a snapshot.
+int escribe_snapshot(const BancoSemillas *banco, const char *ruta, const struct stat *origen, uint64_t hash_origen) {
+    CabeceraSnapshot cabecera = {
+        .magia = {'S', 'E', 'M', 'B'},
+        .version = SNAPSHOT_VERSION,
+        .n_semillas = banco->n_semillas,
+        .n_vivas = banco->n_vivas,
+        .tam_origen = origen->st_size,
+        .seg_origen = origen->st_mtim.tv_sec,
+        .nseg_origen = origen->st_mtim.tv_nsec,
+        .hash_origen = hash_origen
+    };
+
+    // Every column starts aligned, right after the previous one
+    uint64_t desplazamiento = (sizeof(cabecera) + SNAPSHOT_ALINEACION - 1) / SNAPSHOT_ALINEACION * SNAPSHOT_ALINEACION;
+    for (int c = 0; c < N_COLUMNAS; c++) {
+        cabecera.desplazamiento[c] = desplazamiento;
+        desplazamiento += banco->n_semillas * tam_columnas[c];
+        desplazamiento = (desplazamiento + SNAPSHOT_ALINEACION - 1) / SNAPSHOT_ALINEACION * SNAPSHOT_ALINEACION;
+    }
+
+    char ruta_temporal[256];
+    snprintf(ruta_temporal, sizeof(ruta_temporal), "%s.tmp", ruta);
+
+    Escritor escritor;
+    if (escritor_abre(&escritor, ruta_temporal) == -1) return -1;
+
+    escritor_texto(&escritor, (const char *) &cabecera, sizeof(cabecera));
+
+    void **columnas[N_COLUMNAS];
+    banco_columnas((BancoSemillas *) banco, columnas);
+
+    static const char relleno[SNAPSHOT_ALINEACION] = {0};
+    uint64_t escritos = sizeof(cabecera);
+
+    for (int c = 0; c < N_COLUMNAS; c++) {
+        escritor_texto(&escritor, relleno, cabecera.desplazamiento[c] - escritos);
+        escritor_texto(&escritor, (const char *) *columnas[c], banco->n_semillas * tam_columnas[c]);
+        escritos = cabecera.desplazamiento[c] + banco->n_semillas * tam_columnas[c];
+    }
+
+    if (escritor_cierra(&escritor) == -1 || rename(ruta_temporal, ruta) == -1) {
+        unlink(ruta_temporal);
+        return -1;
+    }
+
+    return 0;
+}
+
+//* Checks the columns of a mapped snapshot that the reports use as array indexes
+//* Every slot must be empty or hold categories and a section a line of semillas.txt could have,
+//* with no negative sample, and the live slots must add up to n_vivas.
+static bool snapshot_valores_validos(const BancoSemillas *banco) {
+    // The 480 valid packed words, marked once instead of unpacking every slot
+    uint8_t validas[1 << 16] = {0};
+    for (int r = RIESGO_EXTREMO; r <= SIN_RIESGO; r++)
+        for (int cr = ARBOL; cr <= PLANTA_TREPADORA; cr++)
+            for (int rp = CON_FLORES; rp <= SIN_FLORES; rp++)
+                for (int ad = DESERTICAS; ad <= OTROS; ad++)
+                    for (int ci = ANUALES; ci <= PERENNES; ci++) validas[EMPAQUETA(r, cr, rp, ad, ci)] = 1;
+
+    size_t vivas = 0;
+
+    for (size_t i = 0; i < banco->n_semillas; i++) {
+        if (banco->vCategorias[i] == SLOT_VACIO) continue;
+
+        if (!validas[banco->vCategorias[i]] || banco->vSeccion[i] < 1 || banco->vSeccion[i] > N_SECCIONES ||
+            banco->vNumSemillas[i] < 0) return false;
+        vivas++;
+    }
+
+    return vivas == banco->n_vivas;
+}
+
+//* Function to map a binary snapshot into the bank
+//* With hash_origen NULL the snapshot must have been written from a semillas.txt with the size and
+//* modification time of `origen`; otherwise, with its size and that checksum.
+//* Returns -1 (leaving the bank untouched) if the snapshot is missing, damaged, from another
+//* version or written from a different semillas.txt. The mapping is private, so later
+//* changes to the bank never reach the file.
+int lee_snapshot(BancoSemillas *banco, const char *ruta, const struct stat *origen, const uint64_t *hash_origen) {
+    struct timespec t_inicio, t_fin;
+    clock_gettime(CLOCK_MONOTONIC, &t_inicio);
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_LEE_SNAPSHOT);
+
+    int fd = open(ruta, O_RDONLY);
+    if (fd == -1) return -1;
+
+    struct stat info;
+    CabeceraSnapshot cabecera;
+
+    if (fstat(fd, &info) == -1 || info.st_size < (off_t) sizeof(cabecera) ||
+        pread(fd, &cabecera, sizeof(cabecera), 0) != (ssize_t) sizeof(cabecera)) {
+        close(fd);
+        return -1;
+    }
+
+    bool mismo_origen = cabecera.tam_origen == (uint64_t) origen->st_size &&
+                        (hash_origen != NULL ? cabecera.hash_origen == *hash_origen
+                                             : cabecera.seg_origen == origen->st_mtim.tv_sec && cabecera.nseg_origen == origen->st_mtim.tv_nsec);
+
+    // Stale or foreign snapshot
+    if (memcmp(cabecera.magia, "SEMB", 4) != 0 || cabecera.version != SNAPSHOT_VERSION || !mismo_origen ||
+        cabecera.n_vivas > cabecera.n_semillas || cabecera.n_semillas > MAX_IDENTIFICADOR) {
+        close(fd);
+        return -1;
+    }
+
+    // Every column must be aligned, after the header and the previous column, and inside the file
+    // (n_semillas is bounded above, so the sizes cannot overflow)
+    uint64_t fin_anterior = sizeof(cabecera);
+    for (int c = 0; c < N_COLUMNAS; c++) {
+        uint64_t tam_columna = cabecera.n_semillas * tam_columnas[c];
+
+        if (cabecera.desplazamiento[c] % SNAPSHOT_ALINEACION != 0 || cabecera.desplazamiento[c] < fin_anterior ||
+            cabecera.desplazamiento[c] > (uint64_t) info.st_size || tam_columna > (uint64_t) info.st_size - cabecera.desplazamiento[c]) {
+            close(fd);
+            return -1;
+        }
+        fin_anterior = cabecera.desplazamiento[c] + tam_columna;
+    }
+
+    char *mapa = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED) return -1;
+
+    BancoSemillas mapeado = {0};
+
+    void **columnas[N_COLUMNAS];
+    banco_columnas(&mapeado, columnas);
+    for (int c = 0; c < N_COLUMNAS; c++) *columnas[c] = mapa + cabecera.desplazamiento[c];
+
+    mapeado.n_semillas = cabecera.n_semillas;
+    mapeado.n_vivas = cabecera.n_vivas;
+    mapeado.capacidad = cabecera.n_semillas;
+    mapeado.mapa = mapa;
+    mapeado.tam_mapa = info.st_size;
+
+    if (!snapshot_valores_validos(&mapeado)) {
+        munmap(mapa, info.st_size);
+        return -1;
+    }
+
+    banco_libera(banco);
+    *banco = mapeado;
+
+    clock_gettime(CLOCK_MONOTONIC, &t_fin);
+    double segundos = (t_fin.tv_sec - t_inicio.tv_sec) + (t_fin.tv_nsec - t_inicio.tv_nsec) / 1e9;
+
+    fprintf(stderr, "Cargadas %zu semillas de %s en %.3f ms\n", banco->n_vivas, ruta, segundos * 1000);
+
+    tramo_cierra(&tramo, banco->n_semillas, banco->n_vivas);
+    return 0;
+}
+
+
+//* Function to compute the donation counts of the whole bank (the risk and biome counts are in the cube)
+//* Built with one pass after loading; delta files keep it up to date afterwards.
+int resumen_construye(Agregados *resumen, const BancoSemillas *banco) {
+    FiltroDonacion filtro;
+    if (filtro_crea(&filtro, banco) == -1) return -1;
+
+    recorre_banco(banco, INFORME_DONACION, &filtro, resumen);
+
+    filtro_libera(&filtro);
+    return 0;
+}
+
+//* Adds (signo = 1) or removes (signo = -1) the seed with index i from the counts of the summary
+static void resumen_suma(Agregados *resumen, const BancoSemillas *banco, size_t i, int signo) {
+    // Same rules as the donation report, for one seed
+    uint64_t mascaras[6];
+    filtra_bloque_escalar(banco, i, 1, mascaras);
+
+    if (mascaras[0] & 1) {
+        if ((mascaras[1] | mascaras[2] | mascaras[3] | mascaras[4]) & 1) resumen->contadorNoDonadas += signo;
+        else resumen->contadorDonadas += signo;
+    }
+}
+
+//* Makes the prefix sums of the expiration index cover the years [anyo_min, anyo_max]
+static int indice_cubre(IndiceCaducidad *indice, int anyo_min, int anyo_max) {
+    int viejo_min = indice->anyo_min, viejo_fin = indice->anyo_min + indice->n_anyos;
+
+    if (indice->n_anyos == 0) viejo_min = viejo_fin = anyo_min; // Empty bank
+    if (anyo_min >= viejo_min && anyo_max < viejo_fin) return 0;
+
+    int nuevo_min = anyo_min < viejo_min ? anyo_min : viejo_min;
+    int nuevo_fin = anyo_max + 1 > viejo_fin ? anyo_max + 1 : viejo_fin;
+    int n_anyos = nuevo_fin - nuevo_min;
+
+    size_t *semillas_hasta = malloc((n_anyos + 1) * sizeof(size_t));
+    long long *muestras_hasta = malloc((n_anyos + 1) * sizeof(long long));
+
+    if (semillas_hasta == NULL || muestras_hasta == NULL) {
+        free(semillas_hasta);
+        free(muestras_hasta);
+        return -1;
+    }
+
+    // Years before the old range have no seeds, years after it have all of them
+    for (int k = 0; k <= n_anyos; k++) {
+        int viejo_k = nuevo_min + k - viejo_min;
+        if (viejo_k < 0) viejo_k = 0;
+        if (viejo_k > indice->n_anyos) viejo_k = indice->n_anyos;
+
+        semillas_hasta[k] = indice->semillas_hasta[viejo_k];
+        muestras_hasta[k] = indice->muestras_hasta[viejo_k];
+    }
+
+    free(indice->semillas_hasta);
+    free(indice->muestras_hasta);
+    indice->semillas_hasta = semillas_hasta;
+    indice->muestras_hasta = muestras_hasta;
+    indice->anyo_min = nuevo_min;
+    indice->n_anyos = n_anyos;
+    return 0;
+}
+
+//* Adds (signo = 1) or removes (signo = -1) the seed with index i from the prefix sums
+//* Costs one step per year after its expiration year, never a pass over the bank.
+static void indice_suma(IndiceCaducidad *indice, const BancoSemillas *banco, size_t i, int signo) {
+    for (int k = banco->vCaducidad[i] - indice->anyo_min + 1; k <= indice->n_anyos; k++) {
+        indice->semillas_hasta[k] += signo;
+        indice->muestras_hasta[k] += signo * (long long) banco->vNumSemillas[i];
+    }
+
+    indice->ordenado = false;
+}
+
+//* Makes room in the cube for the expiration years [anyo_min, anyo_max]
+//* If the cube would span more than MAX_ANYOS_CUBO years it keeps only the totals
+static int cubo_cubre(Cubo *cubo, int anyo_min, int anyo_max) {
+    if (!cubo->por_anyo) return 0;
+
+    int viejo_min = cubo->anyo_min, viejo_fin = cubo->anyo_min + cubo->n_anyos;
+
+    if (cubo->n_anyos == 0) viejo_min = viejo_fin = anyo_min; // Empty bank
+    if (anyo_min >= viejo_min && anyo_max < viejo_fin) return 0;
+
+    int nuevo_min = anyo_min < viejo_min ? anyo_min : viejo_min;
+    int nuevo_fin = anyo_max + 1 > viejo_fin ? anyo_max + 1 : viejo_fin;
+    bool por_anyo = nuevo_fin - nuevo_min <= MAX_ANYOS_CUBO;
+    int n_anyos = por_anyo ? nuevo_fin - nuevo_min : 1;
+
+    int32_t *semillas = malloc((size_t) (n_anyos + 1) * CUBO_CELDAS * sizeof(int32_t));
+    int64_t *muestras = malloc((size_t) (n_anyos + 1) * CUBO_CELDAS * sizeof(int64_t));
+
+    if (semillas == NULL || muestras == NULL) {
+        free(semillas);
+        free(muestras);
+        return -1;
+    }
+
+    // Years before the old range have no seeds, years after it have all of them
+    for (int k = 0; k <= n_anyos; k++) {
+        int viejo_k = por_anyo ? nuevo_min + k - viejo_min : k * cubo->n_anyos;
+        if (viejo_k < 0) viejo_k = 0;
+        if (viejo_k > cubo->n_anyos) viejo_k = cubo->n_anyos;
+
+        memcpy(semillas + (size_t) k * CUBO_CELDAS, cubo->semillas + (size_t) viejo_k * CUBO_CELDAS, CUBO_CELDAS * sizeof(int32_t));
+        memcpy(muestras + (size_t) k * CUBO_CELDAS, cubo->muestras + (size_t) viejo_k * CUBO_CELDAS, CUBO_CELDAS * sizeof(int64_t));
+    }
+
+    free(cubo->semillas);
+    free(cubo->muestras);
+    cubo->semillas = semillas;
+    cubo->muestras = muestras;
+    cubo->anyo_min = por_anyo ? nuevo_min : 0;
+    cubo->n_anyos = n_anyos;
+    cubo->por_anyo = por_anyo;
+    return 0;
+}
+
+//* Adds (signo = 1) or removes (signo = -1) the seed with index i from the slices of the cube
+static void cubo_suma(Cubo *cubo, const BancoSemillas *banco, size_t i, int signo) {
+    size_t celda = cubo_celda(banco, i);
+    int k_inicio = cubo->por_anyo ? banco->vCaducidad[i] - cubo->anyo_min + 1 : 1;
+
+    for (int k = k_inicio; k <= cubo->n_anyos; k++) {
+        cubo->semillas[(size_t) k * CUBO_CELDAS + celda] += signo;
+        cubo->muestras[(size_t) k * CUBO_CELDAS + celda] += signo * (int64_t) banco->vNumSemillas[i];
+    }
+}
+
+//* Makes the categorical bitmaps cover n_semillas slots (the words of every bitmap are moved)
+static int bitmaps_reserva(IndiceBitmaps *bitmaps, size_t n_semillas) {
+    size_t n_palabras = (n_semillas + 63) / 64;
+    if (n_palabras <= bitmaps->n_palabras) return 0;
+
+    if (n_palabras < 2 * bitmaps->n_palabras) n_palabras = 2 * bitmaps->n_palabras;
+
+    size_t n_mapas = 1;
+    for (int c = 0; c < N_CAMPOS; c++) n_mapas += valores_campo[c];
+
+    uint64_t *palabras = calloc(n_mapas * n_palabras + 1, sizeof(uint64_t));
+    if (palabras == NULL) return -1;
+
+    size_t viejas = bitmaps->n_palabras * sizeof(uint64_t);
+
+    memcpy(palabras, bitmaps->vivas, viejas);
+    uint64_t *siguiente = palabras + n_palabras;
+    for (int c = 0; c < N_CAMPOS; c++) {
+        for (int v = 0; v < valores_campo[c]; v++) {
+            memcpy(siguiente, bitmaps->valor[c][v], viejas);
+            bitmaps->valor[c][v] = siguiente;
+            siguiente += n_palabras;
+        }
+    }
+
+    free(bitmaps->vivas);
+    bitmaps->vivas = palabras;
+    bitmaps->n_palabras = n_palabras;
+    return 0;
+}
+
+//* Sets (signo = 1) or clears (signo = -1) the bits of the seed with index i in the bitmaps of its values
+static void bitmaps_suma(IndiceBitmaps *bitmaps, const BancoSemillas *banco, size_t i, int signo) {
+    uint16_t categorias = banco->vCategorias[i];
+    uint64_t *mapas[N_CAMPOS + 1] = {
+        bitmaps->vivas,
+        bitmaps->valor[CAMPO_RIESGO][CATEGORIA(categorias, RIESGO) - 1],
+        bitmaps->valor[CAMPO_CRECIMIENTO][CATEGORIA(categorias, CRECIMIENTO) - 1],
+        bitmaps->valor[CAMPO_REPRODUCCION][CATEGORIA(categorias, REPRODUCCION) - 1],
+        bitmaps->valor[CAMPO_ADAPTACION][CATEGORIA(categorias, ADAPTACION) - 1],
+        bitmaps->valor[CAMPO_CICLO][CATEGORIA(categorias, CICLO) - 1],
+        bitmaps->valor[CAMPO_BIOMA][banco->vSeccion[i] % 10]
+    };
+
+    uint64_t bit = (uint64_t) 1 << (i % 64);
+
+    for (int m = 0; m <= N_CAMPOS; m++) {
+        if (signo > 0) mapas[m][i / 64] |= bit;
+        else mapas[m][i / 64] &= ~bit;
+    }
+}
+
+//* One line of a delta file
+typedef struct {
+    char operacion;  // '+' adds or replaces a seed, '-' removes it
+    int campos[10];  // Fields of semillas.txt (only the identifier for '-')
+} CambioDelta;
+
+//* Reads the lines of a delta file into `cambios` (grown with realloc)
+//* Returns the number of changes, -1 if the file cannot be read or -2 (with the line in
+//* *linea_erronea) if a line is not valid.
+static long lee_delta(const char *ruta, CambioDelta **cambios, int *linea_erronea) {
+    FILE *file = fopen(ruta, "r");
+    if (file == NULL) return -1;
+
+    char *linea = NULL;
+    size_t tam_linea = 0, capacidad = 0;
+    long n = 0;
+    int n_linea = 0;
+
+    *cambios = NULL;
+
+    while (getline(&linea, &tam_linea, file) != -1) {
+        n_linea++;
+
+        char *p = linea;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\n' || *p == '\r' || *p == '\0' || *p == '#') continue; // Empty line or comment
+
+        if (n == (long) capacidad) {
+            capacidad = capacidad > 0 ? capacidad * 2 : 256;
+            CambioDelta *nuevos = realloc(*cambios, capacidad * sizeof(CambioDelta));
+            if (nuevos == NULL) {
+                n = -1;
+                break;
+            }
+            *cambios = nuevos;
+        }
+
+        CambioDelta *cambio = &(*cambios)[n];
+        cambio->operacion = *p++;
+
+        int esperados = cambio->operacion == '+' ? 10 : 1, leidos = 0;
+        char *fin;
+
+        for (long v = strtol(p, &fin, 10); fin != p && leidos < 10; v = strtol(p, &fin, 10)) {
+            cambio->campos[leidos++] = v < 0 || v > INT32_MAX ? -1 : (int) v;
+            p = fin;
+        }
+
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+
+        bool valido = (cambio->operacion == '+' || cambio->operacion == '-') && leidos == esperados && *p == '\0' &&
+                      cambio->campos[0] >= 1 && (cambio->operacion == '-' || campos_validos(cambio->campos));
+
+        if (!valido) {
+            *linea_erronea = n_linea;
+            n = -2;
+            break;
+        }
+
+        n++;
+    }
+
+    free(linea);
+    fclose(file);
+
+    if (n < 0) {
+        free(*cambios);
+        *cambios = NULL;
+    }
+    return n;
+}
+
+//* Function to apply a delta file to the loaded bank
+//* Each line is "+ <the 10 fields of a line of semillas.txt>", which adds the seed or replaces
+//* the one with that identifier, or "- <identificador>", which removes it (if it is there).
+//* The summary, the prefix sums of the expiration index and the categorical bitmaps are
+//* updated seed by seed, so the cost depends on the changes and not on the size of the bank.
+//* The whole file is checked and the memory reserved before the first change, so an invalid
+//* file leaves the bank untouched. Returns -1 if the file cannot be read or there is no
+//* memory, and -2 if a line is not valid.
+int aplica_delta(BancoSemillas *banco, IndiceCaducidad *indice, IndiceBitmaps *bitmaps, Cubo *cubo, Agregados *resumen, const char *ruta) {
+    struct timespec t_inicio, t_fin;
+    clock_gettime(CLOCK_MONOTONIC, &t_inicio);
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_DELTA);
+
+    CambioDelta *cambios;
+    int linea_erronea = 0;
+    long n = lee_delta(ruta, &cambios, &linea_erronea);
+
+    if (n == -2) {
+        fprintf(stderr, "Error: La linea %d del archivo %s no es valida\n", linea_erronea, ruta);
+        tramo_cierra(&tramo, 0, 0);
+        return -2;
+    }
+    if (n == -1) {
+        tramo_cierra(&tramo, 0, 0);
+        return -1;
+    }
+
+    // Room for the highest identifier and the expiration years of the file
+    size_t n_slots = banco->n_semillas;
+    int anyo_min = INT32_MAX, anyo_max = -1; // Expiration year 0 is valid, so -1 means no "+" lines
+
+    for (long j = 0; j < n; j++) {
+        if (cambios[j].operacion != '+') continue;
+
+        if ((size_t) cambios[j].campos[0] > n_slots) n_slots = cambios[j].campos[0];
+        if (cambios[j].campos[2] < anyo_min) anyo_min = cambios[j].campos[2];
+        if (cambios[j].campos[2] > anyo_max) anyo_max = cambios[j].campos[2];
+    }
+
+    if (banco_reserva(banco, n_slots) == -1 || bitmaps_reserva(bitmaps, n_slots) == -1 ||
+        (anyo_min <= anyo_max && (indice_cubre(indice, anyo_min, anyo_max) == -1 || cubo_cubre(cubo, anyo_min, anyo_max) == -1))) {
+        free(cambios);
+        tramo_cierra(&tramo, n, 0); // Read but not applied
+        return -1;
+    }
+
+    int altas = 0, bajas = 0;
+
+    for (long j = 0; j < n; j++) {
+        const int *campos = cambios[j].campos;
+        size_t i = (size_t) campos[0] - 1;
+
+        // The old values of the seed leave every aggregate first
+        if (i < banco->n_semillas && banco->vCategorias[i] != SLOT_VACIO) {
+            resumen_suma(resumen, banco, i, -1);
+            indice_suma(indice, banco, i, -1);
+            cubo_suma(cubo, banco, i, -1);
+            bitmaps_suma(bitmaps, banco, i, -1);
+            vacia_semilla(banco, i);
+            banco->n_vivas--;
+        }
+
+        if (cambios[j].operacion == '-') {
+            bajas++;
+            continue;
+        }
+
+        coloca_semilla(banco, i, campos);
+        banco->n_vivas++;
+        if (i >= banco->n_semillas) banco->n_semillas = i + 1;
+
+        resumen_suma(resumen, banco, i, 1);
+        indice_suma(indice, banco, i, 1);
+        cubo_suma(cubo, banco, i, 1);
+        bitmaps_suma(bitmaps, banco, i, 1);
+        altas++;
+    }
+
+    free(cambios);
+
+    clock_gettime(CLOCK_MONOTONIC, &t_fin);
+    double segundos = (t_fin.tv_sec - t_inicio.tv_sec) + (t_fin.tv_nsec - t_inicio.tv_nsec) / 1e9;
+
+    fprintf(stderr, "Aplicados %d altas o modificaciones y %d bajas de %s en %.3f ms\n", altas, bajas, ruta, segundos * 1000);
+
+    tramo_cierra(&tramo, n, altas + bajas);
+    return 0;
+}
+
+//* Reads a range of expiration years from two words of a batch line (same rules as pide_rango_anyos)
+static bool lee_rango_lote(const char *inicio, const char *fin, int *start_year, int *end_year) {
+    char *resto1, *resto2;
+    long a = strtol(inicio, &resto1, 10);
+    long b = strtol(fin, &resto2, 10);
+
+    if (*resto1 != '\0' || *resto2 != '\0' || a < 2020 || b < a || b > UINT16_MAX) return false;
+
+    *start_year = (int) a;
+    *end_year = (int) b;
+    return true;
+}
+
+//* Reads the words campo=v1,v2,... of a batch line into a query; a word without '=' is the output file
+static bool lee_consulta_lote(char *palabras[], int n, Consulta *consulta, const char **ruta) {
+
+    *consulta = (Consulta) {0};
+
+    for (int j = 0; j < n; j++) {
+        char *igual = strchr(palabras[j], '=');
+
+        if (igual == NULL) {
+            if (*ruta != NULL) return false; // Only one output file
+            *ruta = palabras[j];
+            continue;
+        }
+
+        *igual = '\0';
+
+        int campo = 0;
+        while (campo < N_CAMPOS && strcmp(palabras[j], campo_claves[campo]) != 0) campo++;
+        if (campo == N_CAMPOS) return false;
+
+        // Values separated by commas; 0 accepts any value
+        char *p = igual + 1, *fin;
+        do {
+            long v = strtol(p, &fin, 10);
+            if (fin == p || v < 0 || v > valores_campo[campo]) return false;
+            if (v > 0) consulta->valores[campo] |= 1u << (v - 1);
+            p = fin + 1;
+        } while (*fin == ',');
+
+        if (*fin != '\0') return false;
+    }
+
+    return true;
+}
+
+//* Reads the words of a `cubo` line: the slice of lee_consulta_lote, plus caducidad=<anyo>-<anyo>
+//* for a range of expiration years and por=<campo> to group by the values of a field
+static bool lee_cubo_lote(char *palabras[], int n, Consulta *consulta, int *campo, int *start_year, int *end_year) {
+    char *corte[MAX_PALABRAS_LOTE];
+    int n_corte = 0;
+
+    *campo = -1;
+    *start_year = 0;
+    *end_year = UINT16_MAX;
+
+    for (int j = 0; j < n; j++) {
+        if (strncmp(palabras[j], "caducidad=", 10) == 0) {
+            char *guion = strchr(palabras[j] + 10, '-');
+            if (guion == NULL) return false;
+
+            *guion = '\0';
+            if (!lee_rango_lote(palabras[j] + 10, guion + 1, start_year, end_year)) return false;
+        } else if (strncmp(palabras[j], "por=", 4) == 0) {
+            *campo = 0;
+            while (*campo < N_CAMPOS && strcmp(palabras[j] + 4, campo_claves[*campo]) != 0) (*campo)++;
+            if (*campo == N_CAMPOS) return false;
+        } else {
+            corte[n_corte++] = palabras[j];
+        }
+    }
+
+    const char *ruta = NULL;
+    return lee_consulta_lote(corte, n_corte, consulta, &ruta) && ruta == NULL;
+}
+
+//* Reads the words of an `ordena` line: caducadas <anyo> <anyo> or donadas, then optionally
+//* por=<clave> (orden_claves), top=<n> and the output file
+static bool lee_listado_lote(char *palabras[], int n, ListadoOrdenado *listado) {
+    int j;
+
+    *listado = (ListadoOrdenado) {0};
+
+    if (n >= 3 && strcmp(palabras[0], "caducadas") == 0) {
+        if (!lee_rango_lote(palabras[1], palabras[2], &listado->start_year, &listado->end_year)) return false;
+        listado->orden = ORDEN_CADUCIDAD;
+        listado->ruta = "caducadas_ordenadas.txt";
+        j = 3;
+    } else if (n >= 1 && strcmp(palabras[0], "donadas") == 0) {
+        listado->donadas = true;
+        listado->orden = ORDEN_RESTANTES;
+        listado->ruta = "donadas_ordenadas.txt";
+        j = 1;
+    } else {
+        return false;
+    }
+
+    bool con_ruta = false;
+
+    for (; j < n; j++) {
+        if (strncmp(palabras[j], "por=", 4) == 0) {
+            listado->orden = 0;
+            while (listado->orden < N_ORDENES && strcmp(palabras[j] + 4, orden_claves[listado->orden]) != 0) listado->orden++;
+            if (listado->orden == N_ORDENES) return false;
+        } else if (strncmp(palabras[j], "top=", 4) == 0) {
+            char *fin;
+            long top = strtol(palabras[j] + 4, &fin, 10);
+            if (fin == palabras[j] + 4 || *fin != '\0' || top < 1) return false;
+            listado->top = (size_t) top;
+        } else {
+            if (con_ruta) return false; // Only one output file
+            listado->ruta = palabras[j];
+            con_ruta = true;
+        }
+    }
+
+    return true;
+}
+
+//* Runs one line of a batch script, already split in words
+//* Returns -1 if the line is not valid or its report files could not be written.
+static int ejecuta_orden(BancoSemillas *banco, IndiceCaducidad *indice, IndiceBitmaps *bitmaps, Cubo *cubo, Agregados *resumen,
+                         char *palabras[], int n) {
+
+    const char *orden = palabras[0];
+    int start_year, end_year;
+
+    if (strcmp(orden, "peligro") == 0 && n == 1) {
+        peligro_extincion(cubo);
+        return 0;
+    }
+
+    if (strcmp(orden, "caducidad") == 0 && (n == 3 || n == 4) && lee_rango_lote(palabras[1], palabras[2], &start_year, &end_year)) {
+        return caducidad_semillas(banco, indice, start_year, end_year, n == 4 ? palabras[3] : "caducadas.txt");
+    }
+
+    if (strcmp(orden, "bioma") == 0 && (n == 1 || n == 2)) {
+        return especies_bioma(banco, cubo, n == 2 ? palabras[1] : "bioma.txt");
+    }
+
+    if (strcmp(orden, "donacion") == 0 && (n == 1 || n == 3)) {
+        int contadorDonadas, contadorNoDonadas;
+
+        if (donacion(banco, n == 3 ? palabras[1] : "donadas.txt", n == 3 ? palabras[2] : "nodonadas.txt",
+                     &contadorDonadas, &contadorNoDonadas) == -1) return -1;
+
+        imprime_donacion(contadorDonadas, contadorNoDonadas, banco->n_vivas);
+        return 0;
+    }
+
+    if (strcmp(orden, "todos") == 0 && n == 3 && lee_rango_lote(palabras[1], palabras[2], &start_year, &end_year)) {
+        return todos_los_informes(banco, indice, cubo, resumen, start_year, end_year);
+    }
+
+    if (strcmp(orden, "delta") == 0 && n == 2) {
+        return aplica_delta(banco, indice, bitmaps, cubo, resumen, palabras[1]) == 0 ? 0 : -1;
+    }
+
+    Consulta consulta;
+    const char *ruta = NULL;
+
+    if (strcmp(orden, "consulta") == 0 && lee_consulta_lote(palabras + 1, n - 1, &consulta, &ruta)) {
+        return consulta_categorias(banco, bitmaps, &consulta, ruta != NULL ? ruta : "consulta.txt");
+    }
+
+    ListadoOrdenado listado;
+
+    if (strcmp(orden, "ordena") == 0 && lee_listado_lote(palabras + 1, n - 1, &listado)) {
+        return ordena_listado(banco, indice, &listado);
+    }
+
+    int campo;
+
+    if (strcmp(orden, "cubo") == 0 && lee_cubo_lote(palabras + 1, n - 1, &consulta, &campo, &start_year, &end_year)) {
+        return cubo_informe(banco, cubo, &consulta, campo, start_year, end_year);
+    }
+
+    const TablaConteo *tabla = n == 2 && strcmp(orden, "tabla") == 0 ? busca_tabla(palabras[1]) : NULL;
+
+    if (tabla != NULL) {
+        tabla_conteo(banco, tabla);
+        return 0;
+    }
+
+    fprintf(stderr, "Error: Orden no valida o con parametros incorrectos: %s\n", orden);
+    return -1;
+}
+
+//* Function to run a batch script against the loaded bank (./practica_8 --lote [guion])
+//* The script is read from the file `guion`, or from stdin if it is missing or "-".
+//* Each line is one report, like the menu options, with its parameters as words:
+//*     peligro
+//*     caducidad <anyo inicio> <anyo fin> [fichero]
+//*     bioma [fichero]
+//*     donacion [fichero donadas] [fichero nodonadas]
+//*     todos <anyo inicio> <anyo fin>
+//*     consulta [riesgo=1,2] [crecimiento=..] [reproduccion=..] [adaptacion=..] [ciclo=..] [bioma=..] [fichero]
+//*     delta <fichero>   (applies a delta file, see aplica_delta; later lines see the changes)
+//*     tabla <nombre>    (one of the count tables of TABLAS_CONTEO, e.g. riesgo_ciclo)
+//*     cubo [riesgo=1,2] [..] [caducidad=<anyo>-<anyo>] [por=<campo>]   (answered from the cube)
+//*     ordena caducadas <anyo> <anyo> | donadas [por=caducidad|restantes|muestra|seccion] [top=<n>] [fichero]
+//* Empty lines and text after '#' are skipped. A bad line is reported and the script goes on;
+//* the result is 1 if any line failed.
+int lote(int argc, char *argv[], BancoSemillas *banco, IndiceCaducidad *indice, IndiceBitmaps *bitmaps, Cubo *cubo, Agregados *resumen) {
+
+    FILE *guion = stdin;
+
+    if (argc > 0 && strcmp(argv[0], "-") != 0) {
+        guion = fopen(argv[0], "r");
+        if (guion == NULL) {
+            fprintf(stderr, "Error: No se pudo abrir el archivo %s\n", argv[0]);
+            return 1;
+        }
+    }
+
+    char *linea = NULL;
+    size_t tam_linea = 0;
+    int n_linea = 0, fallos = 0;
+
+    while (getline(&linea, &tam_linea, guion) != -1) {
+        n_linea++;
+
+        char *comentario = strchr(linea, '#');
+        if (comentario != NULL) *comentario = '\0';
+
+        char *palabras[MAX_PALABRAS_LOTE];
+        int n = 0;
+        char *resto;
+
+        for (char *palabra = strtok_r(linea, " \t\r\n", &resto); palabra != NULL; palabra = strtok_r(NULL, " \t\r\n", &resto)) {
+            if (n == MAX_PALABRAS_LOTE) {
+                n = -1;
+                break;
+            }
+            palabras[n++] = palabra;
+        }
+
+        if (n == 0) continue;
+
+        printf("\n>>> Linea %d:", n_linea);
+        for (int j = 0; j < n; j++) printf(" %s", palabras[j]);
+        printf("\n");
+
+        if (n == -1 || ejecuta_orden(banco, indice, bitmaps, cubo, resumen, palabras, n) == -1) {
+            fprintf(stderr, "Error: La linea %d del guion ha fallado\n", n_linea);
+            fallos++;
+        }
+    }
+
+    free(linea);
+    if (guion != stdin) fclose(guion);
+
+    return fallos > 0 ? 1 : 0;
+}
+
+//* Set by SIGINT and SIGTERM to stop the server after the current request
+static volatile sig_atomic_t servidor_parar = 0;
+
+static void servidor_senyal(int senyal) {
+    (void) senyal;
+    servidor_parar = 1;
+}
+
+//* Data the server answers from, and what it knows about the file it was loaded from
+typedef struct {
+    BancoSemillas *banco;
+    IndiceCaducidad *indice;
+    IndiceBitmaps *bitmaps;
+    Cubo *cubo;
+    Agregados *resumen;
+    struct stat origen;          // semillas.txt when it was loaded (size and modification time)
+    unsigned long version;       // Goes up with every reload or delta file; the cache only holds this version
+    CacheRespuestas cache;
+    int fd_captura;              // Temporary file the standard output goes to while a command runs
+} Servidor;
+
+//* One connection of the server: the text of its next requests and the answers it has not read
+typedef struct {
+    int fd;                              // Non-blocking socket
+    char pendiente[MAX_LINEA_SERVIDOR];  // Text received and not answered yet
+    size_t usado;
+    char *salida;                        // Answers waiting for POLLOUT
+    size_t n_salida, enviado, cap_salida;
+    bool cerrar;                         // Close once the answers are sent (its line was too long)
+    bool error;                          // Close now (it went away or memory ran out)
+} ClienteServidor;
+
+//* Forgets every cached response (the data changed)
+static void cache_vacia(CacheRespuestas *cache) {
+    for (int e = 0; e < MAX_ENTRADAS_CACHE; e++) {
+        free(cache->entradas[e].clave);
+        free(cache->entradas[e].respuesta);
+        cache->entradas[e].clave = NULL;
+        cache->entradas[e].respuesta = NULL;
+    }
+}
+
+//* Cached response to a request, or -1
+static int cache_busca(const CacheRespuestas *cache, const char *clave, uint64_t hash) {
+    for (int e = 0; e < MAX_ENTRADAS_CACHE; e++) {
+        if (cache->entradas[e].clave != NULL && cache->entradas[e].hash == hash && strcmp(cache->entradas[e].clave, clave) == 0) return e;
+    }
+    return -1;
+}
+
+//* Stores a response in a free entry or in place of the least recently used one (it owns `respuesta`)
+static void cache_guarda(CacheRespuestas *cache, const char *clave, uint64_t hash, char *respuesta, size_t len) {
+    int elegida = 0;
+
+    for (int e = 0; e < MAX_ENTRADAS_CACHE; e++) {
+        if (cache->entradas[e].clave == NULL) {
+            elegida = e;
+            break;
+        }
+        if (cache->entradas[e].uso < cache->entradas[elegida].uso) elegida = e;
+    }
+
+    char *copia = strdup(clave);
+    if (copia == NULL) {
+        free(respuesta);
+        return;
+    }
+
+    free(cache->entradas[elegida].clave);
+    free(cache->entradas[elegida].respuesta);
+    cache->entradas[elegida].hash = hash;
+    cache->entradas[elegida].clave = copia;
+    cache->entradas[elegida].respuesta = respuesta;
+    cache->entradas[elegida].len = len;
+    cache->entradas[elegida].uso = ++cache->reloj;
+}
+
+//* Loads semillas.txt again into a new bank and its indexes, and replaces the old ones if it worked
+//* Returns the error of carga_banco (-1, -2) or -3 without memory; the old data stays on any error
+static int servidor_recarga(Servidor *srv) {
+    BancoSemillas banco;
+    IndiceCaducidad indice;
+    IndiceBitmaps bitmaps;
+    Cubo cubo;
+    Agregados resumen;
+
+    if (banco_inicializa(&banco) == -1) return -3;
+
+    int resultado = carga_banco(&banco);
+    if (resultado != 0) {
+        banco_libera(&banco);
+        return resultado;
+    }
+
+    bool con_indice = indice_construye(&indice, &banco) == 0;
+    bool con_bitmaps = con_indice && bitmaps_construye(&bitmaps, &banco) == 0;
+    bool con_cubo = con_bitmaps && cubo_construye(&cubo, &banco) == 0;
+
+    if (!con_cubo || resumen_construye(&resumen, &banco) == -1) {
+        if (con_cubo) cubo_libera(&cubo);
+        if (con_bitmaps) bitmaps_libera(&bitmaps);
+        if (con_indice) indice_libera(&indice);
+        banco_libera(&banco);
+        return -3;
+    }
+
+    cubo_libera(srv->cubo);
+    bitmaps_libera(srv->bitmaps);
+    indice_libera(srv->indice);
+    banco_libera(srv->banco);
+
+    *srv->banco = banco;
+    *srv->indice = indice;
+    *srv->bitmaps = bitmaps;
+    *srv->cubo = cubo;
+    *srv->resumen = resumen;
+    return 0;
+}
+
+//* Reloads the data if semillas.txt changed since it was loaded (one stat per request)
+static void servidor_comprueba_origen(Servidor *srv) {
+    struct stat actual;
+
+    if (stat("semillas.txt", &actual) == -1) return; // Keep answering with the data loaded
+
+    if (actual.st_size == srv->origen.st_size && actual.st_mtim.tv_sec == srv->origen.st_mtim.tv_sec &&
+        actual.st_mtim.tv_nsec == srv->origen.st_mtim.tv_nsec) return;
+
+    int resultado = servidor_recarga(srv);
+    srv->origen = actual; // A file that failed to load is not tried again until it changes
+
+    if (resultado == 0) {
+        srv->version++;
+        cache_vacia(&srv->cache);
+        fprintf(stderr, "Servidor: semillas.txt ha cambiado, recargadas %zu semillas (version %lu)\n", srv->banco->n_vivas, srv->version);
+    } else {
+        fprintf(stderr, "Aviso: No se pudo recargar semillas.txt (error %d); se siguen usando los datos anteriores\n", resultado);
+    }
+}
+
+//* Runs one command with the standard output going to the capture file
+//* Returns the text printed followed by the line "FIN 0" (or "FIN 1" if the command failed, then `fallo` is set)
+static char *servidor_ejecuta(Servidor *srv, char *palabras[], int n, size_t *len, bool *fallo) {
+    fflush(stdout);
+    int guardada = dup(STDOUT_FILENO);
+
+    if (guardada == -1 || ftruncate(srv->fd_captura, 0) == -1 || dup2(srv->fd_captura, STDOUT_FILENO) == -1) {
+        if (guardada != -1) close(guardada);
+        return NULL;
+    }
+    lseek(srv->fd_captura, 0, SEEK_SET);
+
+    int resultado = ejecuta_orden(srv->banco, srv->indice, srv->bitmaps, srv->cubo, srv->resumen, palabras, n);
+
+    fflush(stdout);
+    dup2(guardada, STDOUT_FILENO);
+    close(guardada);
+
+    off_t tam = lseek(srv->fd_captura, 0, SEEK_CUR);
+    char fin[8];
+    int len_fin = snprintf(fin, sizeof(fin), "FIN %d\n", resultado == 0 ? 0 : 1);
+
+    char *texto = malloc((size_t) tam + len_fin);
+    if (texto == NULL || pread(srv->fd_captura, texto, tam, 0) != tam) {
+        free(texto);
+        return NULL;
+    }
+
+    memcpy(texto + tam, fin, len_fin);
+    *len = (size_t) tam + len_fin;
+    *fallo = resultado != 0;
+    return texto;
+}
+
+//* Queues an answer for a client (cliente_vacia sends it)
+static void cliente_encola(ClienteServidor *cliente, const char *texto, size_t len) {
+    if (cliente->n_salida + len > cliente->cap_salida) {
+        size_t cap = cliente->cap_salida > 0 ? cliente->cap_salida : 4096;
+        while (cap < cliente->n_salida + len) cap *= 2;
+
+        char *nueva = realloc(cliente->salida, cap);
+        if (nueva == NULL) {
+            cliente->error = true;
+            return;
+        }
+        cliente->salida = nueva;
+        cliente->cap_salida = cap;
+    }
+
+    memcpy(cliente->salida + cliente->n_salida, texto, len);
+    cliente->n_salida += len;
+}
+
+//* Sends as much of the queued answers as the socket takes without blocking
+static void cliente_vacia(ClienteServidor *cliente) {
+    while (cliente->enviado < cliente->n_salida) {
+        ssize_t enviados = write(cliente->fd, cliente->salida + cliente->enviado, cliente->n_salida - cliente->enviado);
+
+        if (enviados == -1 && errno == EINTR) continue;
+        if (enviados == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return; // The rest waits for POLLOUT
+        if (enviados <= 0) {
+            cliente->error = true;
+            return;
+        }
+        cliente->enviado += enviados;
+    }
+
+    cliente->n_salida = 0;
+    cliente->enviado = 0;
+}
+
+//* Answers one request line of a client: from the cache, or running it and caching the response
+//* Commands that change the data (delta) are never cached and start a new data version; failed ones
+//* are not cached either, since the failure may be a report file that could not be written.
+//* Returns false if the client asked to stop the server
+static bool servidor_atiende(Servidor *srv, ClienteServidor *cliente, char *linea) {
+    char *comentario = strchr(linea, '#');
+    if (comentario != NULL) *comentario = '\0';
+
+    char *palabras[MAX_PALABRAS_LOTE];
+    int n = 0;
+    char *resto;
+
+    for (char *palabra = strtok_r(linea, " \t\r\n", &resto); palabra != NULL; palabra = strtok_r(NULL, " \t\r\n", &resto)) {
+        if (n == MAX_PALABRAS_LOTE) {
+            n = -1;
+            break;
+        }
+        palabras[n++] = palabra;
+    }
+
+    if (n == 0) return true;
+
+    if (n == -1) {
+        cliente_encola(cliente, "FIN 1\n", 6);
+        return true;
+    }
+
+    if (n == 1 && strcmp(palabras[0], "apaga") == 0) {
+        cliente_encola(cliente, "FIN 0\n", 6);
+        return false;
+    }
+
+    servidor_comprueba_origen(srv);
+
+    if (n == 1 && strcmp(palabras[0], "estado") == 0) {
+        char texto[256];
+        int len = snprintf(texto, sizeof(texto),
+                           "Version de los datos %lu: %zu semillas, %llu respuestas desde la cache y %llu calculadas\nFIN 0\n",
+                           srv->version, srv->banco->n_vivas, srv->cache.aciertos, srv->cache.fallos);
+        cliente_encola(cliente, texto, len);
+        return true;
+    }
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_PETICION);
+
+    // Key of the cache: the words with one space between them
+    char clave[MAX_LINEA_SERVIDOR] = "";
+    size_t largo = 0;
+    for (int j = 0; j < n; j++) largo += snprintf(clave + largo, sizeof(clave) - largo, j > 0 ? " %s" : "%s", palabras[j]);
+
+    uint64_t hash = 1469598103934665603ULL;
+    for (const char *c = clave; *c != '\0'; c++) hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+
+    bool cambia_datos = strcmp(palabras[0], "delta") == 0;
+    int entrada = cambia_datos ? -1 : cache_busca(&srv->cache, clave, hash);
+
+    if (entrada != -1) {
+        srv->cache.aciertos++;
+        srv->cache.entradas[entrada].uso = ++srv->cache.reloj;
+        cliente_encola(cliente, srv->cache.entradas[entrada].respuesta, srv->cache.entradas[entrada].len);
+        tramo_cierra(&tramo, 1, 1);
+        return true;
+    }
+
+    size_t len;
+    bool fallo;
+    char *respuesta = servidor_ejecuta(srv, palabras, n, &len, &fallo);
+
+    if (respuesta == NULL) {
+        cliente_encola(cliente, "FIN 1\n", 6);
+        tramo_cierra(&tramo, 1, 0);
+        return true;
+    }
+
+    srv->cache.fallos++;
+    cliente_encola(cliente, respuesta, len);
+
+    if (cambia_datos) {
+        srv->version++;
+        cache_vacia(&srv->cache);
+        free(respuesta);
+    } else if (fallo) {
+        free(respuesta);
+    } else {
+        cache_guarda(&srv->cache, clave, hash, respuesta, len);
+    }
+
+    tramo_cierra(&tramo, 1, 0);
+    return true;
+}
+
+//* Answers the complete lines of a client one after another, as long as each answer is read
+//* A client that stops reading gets nothing more answered until its queued answers are sent,
+//* so it never holds the server and its queue stays within the answers to one read.
+//* Returns false if the client asked to stop the server
+static bool cliente_procesa(Servidor *srv, ClienteServidor *cliente) {
+    char *salto;
+
+    while (cliente->n_salida == 0 && !cliente->error && !cliente->cerrar &&
+           (salto = memchr(cliente->pendiente, '\n', cliente->usado)) != NULL) {
+        *salto = '\0';
+        bool seguir = servidor_atiende(srv, cliente, cliente->pendiente);
+
+        cliente->usado -= salto + 1 - cliente->pendiente;
+        memmove(cliente->pendiente, salto + 1, cliente->usado);
+        cliente_vacia(cliente);
+
+        if (!seguir) return false;
+    }
+
+    // A full buffer without a line break: the line is too long
+    if (cliente->usado == MAX_LINEA_SERVIDOR && memchr(cliente->pendiente, '\n', cliente->usado) == NULL) {
+        cliente_encola(cliente, "FIN 1\n", 6);
+        cliente->usado = 0;
+        cliente->cerrar = true;
+        cliente_vacia(cliente);
+    }
+
+    return true;
+}
+
+//* Function to serve the loaded bank over a Unix socket (./practica_8 --servidor [socket])
+//* Each line a client sends is a command of the batch mode (see lote); the answer is what the
+//* command prints, ended by a line "FIN 0" (or "FIN 1" if it failed). Answers are cached for the
+//* current data version, so repeated questions cost one lookup; a delta file, or a change of
+//* semillas.txt (checked on every request, then reloaded), starts a new version. Report files are
+//* written when the command runs, not when its answer comes from the cache. Two more commands:
+//* "estado" (data version and cache counters) and "apaga" (stops the server, as SIGINT/SIGTERM do).
+//* Try it with: socat - UNIX-CONNECT:semillas.sock
+int servidor(int argc, char *argv[], BancoSemillas *banco, IndiceCaducidad *indice, IndiceBitmaps *bitmaps, Cubo *cubo, Agregados *resumen) {
+
+    const char *ruta = argc > 0 ? argv[0] : SOCKET_SERVIDOR;
+    struct sockaddr_un direccion = {.sun_family = AF_UNIX};
+
+    if (strlen(ruta) >= sizeof(direccion.sun_path)) {
+        fprintf(stderr, "Error: La ruta del socket %s es demasiado larga\n", ruta);
+        return 1;
+    }
+    strcpy(direccion.sun_path, ruta);
+
+    Servidor *srv = calloc(1, sizeof(Servidor));
+    FILE *captura = tmpfile();
+
+    if (srv == NULL || captura == NULL) {
+        free(srv);
+        if (captura != NULL) fclose(captura);
+        fprintf(stderr, "Error: No hay memoria suficiente para el servidor\n");
+        return 1;
+    }
+
+    *srv = (Servidor) {banco, indice, bitmaps, cubo, resumen, .fd_captura = fileno(captura)};
+    stat("semillas.txt", &srv->origen);
+
+    int escucha = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(ruta); // A socket left by a server that did not stop cleanly
+
+    if (escucha == -1 || bind(escucha, (struct sockaddr *) &direccion, sizeof(direccion)) == -1 || listen(escucha, MAX_CLIENTES_SERVIDOR) == -1) {
+        fprintf(stderr, "Error: No se pudo crear el socket %s (%s)\n", ruta, strerror(errno));
+        if (escucha != -1) close(escucha);
+        fclose(captura);
+        free(srv);
+        return 1;
+    }
+
+    // Without SA_RESTART, poll returns on a signal and the loop stops
+    struct sigaction accion = {0};
+    accion.sa_handler = servidor_senyal;
+    sigemptyset(&accion.sa_mask);
+    sigaction(SIGINT, &accion, NULL);
+    sigaction(SIGTERM, &accion, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "Servidor: %zu semillas, escuchando en %s\n", banco->n_vivas, ruta);
+
+    // fds[0] is the listening socket and fds[1 + c] the client c; every socket is non-blocking
+    fcntl(escucha, F_SETFL, fcntl(escucha, F_GETFL) | O_NONBLOCK);
+
+    ClienteServidor clientes[MAX_CLIENTES_SERVIDOR];
+    struct pollfd fds[MAX_CLIENTES_SERVIDOR + 1];
+    int n_clientes = 0;
+    bool seguir = true;
+
+    while (seguir && !servidor_parar) {
+        // With the table full, new connections wait in the backlog until a client leaves
+        fds[0] = (struct pollfd) {.fd = escucha, .events = n_clientes < MAX_CLIENTES_SERVIDOR ? POLLIN : 0};
+        for (int c = 0; c < n_clientes; c++) {
+            fds[c + 1] = (struct pollfd) {.fd = clientes[c].fd, .events = clientes[c].n_salida > 0 ? POLLOUT : POLLIN};
+        }
+
+        int n_atendidos = n_clientes;
+
+        if (poll(fds, n_atendidos + 1, -1) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(escucha, NULL, NULL);
+            if (fd != -1) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                clientes[n_clientes] = (ClienteServidor) {.fd = fd};
+                n_clientes++;
+            }
+        }
+
+        for (int c = 0; c < n_atendidos && seguir; c++) {
+            ClienteServidor *cliente = &clientes[c];
+            if (fds[c + 1].revents == 0) continue;
+
+            if (fds[c + 1].events == POLLOUT) {
+                // Once its answers are out, the requests it already sent are answered
+                cliente_vacia(cliente);
+                seguir = cliente_procesa(srv, cliente);
+                continue;
+            }
+
+            ssize_t leidos = read(cliente->fd, cliente->pendiente + cliente->usado, MAX_LINEA_SERVIDOR - cliente->usado);
+
+            if (leidos > 0) {
+                cliente->usado += leidos;
+                seguir = cliente_procesa(srv, cliente);
+            } else if (leidos == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                cliente->error = true;
+            }
+        }
+
+        // Drop the clients that left, failed or were told their line was too long
+        for (int c = 0; c < n_clientes; ) {
+            if (clientes[c].error || (clientes[c].cerrar && clientes[c].n_salida == 0)) {
+                close(clientes[c].fd);
+                free(clientes[c].salida);
+                clientes[c] = clientes[--n_clientes];
+            } else {
+                c++;
+            }
+        }
+    }
+
+    // Last chance for the answers already queued (the FIN of "apaga")
+    for (int c = 0; c < n_clientes; c++) {
+        cliente_vacia(&clientes[c]);
+        close(clientes[c].fd);
+        free(clientes[c].salida);
+    }
+    close(escucha);
+    unlink(ruta);
+
+    fprintf(stderr, "Servidor: parado tras %llu respuestas desde la cache y %llu calculadas\n", srv->cache.aciertos, srv->cache.fallos);
+
+    cache_vacia(&srv->cache);
+    fclose(captura);
+    free(srv);
+    return 0;
+}
+
+//* Reader of a file in blocks with read-ahead: a thread fills one block while the other is parsed
+typedef struct {
+    int fd;
+    char *bloques[2];
+    size_t tam_bloque;
+    ssize_t leidos[2];      // Bytes in each block (0 at the end of the file, -1 if read failed)
+    bool lleno[2];          // The block is waiting to be parsed
+    int actual;             // Block the parser takes next
+    bool parar;             // The parser has stopped early
+
+    pthread_mutex_t cerrojo;
+    pthread_cond_t cambio;
+    pthread_t hilo;
+} LectorBloques;
+
+//* Reads whole blocks into the free buffers until the end of the file
+static void *lector_bucle(void *arg) {
+    LectorBloques *lector = arg;
+
+    for (int k = 0; ; k ^= 1) {
+        pthread_mutex_lock(&lector->cerrojo);
+        while (lector->lleno[k] && !lector->parar) pthread_cond_wait(&lector->cambio, &lector->cerrojo);
+        bool parar = lector->parar;
+        pthread_mutex_unlock(&lector->cerrojo);
+
+        if (parar) return NULL;
+
+        size_t total = 0;
+        ssize_t n = 1;
+
+        while (total < lector->tam_bloque && n > 0) {
+            n = read(lector->fd, lector->bloques[k] + total, lector->tam_bloque - total);
+            if (n == -1 && errno == EINTR) n = 1;
+            else if (n > 0) total += n;
+        }
+
+        pthread_mutex_lock(&lector->cerrojo);
+        lector->leidos[k] = n == -1 ? -1 : (ssize_t) total;
+        lector->lleno[k] = true;
+        pthread_cond_broadcast(&lector->cambio);
+        pthread_mutex_unlock(&lector->cerrojo);
+
+        if (n == -1 || total == 0) return NULL; // Error or end of file: this block is the last one
+    }
+}
+
+//* Opens `ruta` and starts reading it in blocks of tam_bloque bytes
+static int lector_abre(LectorBloques *lector, const char *ruta, char *bloques[2], size_t tam_bloque) {
+    *lector = (LectorBloques) {0};
+
+    lector->fd = open(ruta, O_RDONLY);
+    if (lector->fd == -1) return -1;
+
+    posix_fadvise(lector->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    lector->bloques[0] = bloques[0];
+    lector->bloques[1] = bloques[1];
+    lector->tam_bloque = tam_bloque;
+    pthread_mutex_init(&lector->cerrojo, NULL);
+    pthread_cond_init(&lector->cambio, NULL);
+
+    if (pthread_create(&lector->hilo, NULL, lector_bucle, lector) != 0) {
+        close(lector->fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+//* Waits for the next block; returns its size (0 at the end of the file, -1 on error)
+static ssize_t lector_siguiente(LectorBloques *lector, const char **bloque) {
+    pthread_mutex_lock(&lector->cerrojo);
+    while (!lector->lleno[lector->actual]) pthread_cond_wait(&lector->cambio, &lector->cerrojo);
+    ssize_t leidos = lector->leidos[lector->actual];
+    pthread_mutex_unlock(&lector->cerrojo);
+
+    *bloque = lector->bloques[lector->actual];
+    return leidos;
+}
+
+//* Gives the block back to the reader once it has been parsed
+static void lector_devuelve(LectorBloques *lector) {
+    pthread_mutex_lock(&lector->cerrojo);
+    lector->lleno[lector->actual] = false;
+    lector->actual ^= 1;
+    pthread_cond_broadcast(&lector->cambio);
+    pthread_mutex_unlock(&lector->cerrojo);
+}
+
+//* Stops the reader thread and closes the file
+static void lector_cierra(LectorBloques *lector) {
+    pthread_mutex_lock(&lector->cerrojo);
+    lector->parar = true;
+    pthread_cond_broadcast(&lector->cambio);
+    pthread_mutex_unlock(&lector->cerrojo);
+
+    pthread_join(lector->hilo, NULL);
+    pthread_mutex_destroy(&lector->cerrojo);
+    pthread_cond_destroy(&lector->cambio);
+    close(lector->fd);
+}
+
+//* Line of semillas.txt kept in the spill file of the streaming mode until its window is loaded
+typedef struct {
+    uint32_t id;
+    uint16_t anyo, caducidad;
+    int32_t num_semillas;
+    uint16_t categorias;
+    uint8_t seccion;
+} RegistroStreaming;
+
+//* Records of one window in the spill file: runs in the order of semillas.txt
+typedef struct {
+    struct {
+        off_t inicio;
+        size_t n;
+    } *rachas;
+    size_t n_rachas, cap_rachas;
+} RepartoVentana;
+
+//* Identifier window of the bank, and the spill file holding the lines of the other windows
+//* The only pass over semillas.txt fills the first window and groups the lines of the rest
+//* by window into the spill file, so each later window reads its own records and nothing else.
+typedef struct {
+    BancoSemillas *banco;  // Slots [0, n) hold the identifiers banco->id_base + 1 .. banco->id_base + n
+    size_t n_slots;        // Size of the window
+    size_t id_max;         // Highest identifier in the whole file
+    bool fin_datos;        // A line without 10 numbers was found: the rest of the file is ignored
+
+    FILE *reparto;                     // Spill file (NULL until a line of another window shows up)
+    off_t fin_reparto;                 // Bytes written to it
+    RegistroStreaming *pendientes;     // Records not written yet, in the order of the file
+    RegistroStreaming *repartidos;     // The same records grouped by window, as they are written
+    size_t n_pendientes, cap_pendientes;
+    RepartoVentana *ventanas;          // [w]: runs of the window of identifiers w * n_slots + 1 ..
+    size_t n_ventanas;
+} VentanaStreaming;
+
+//* Places one line in the slot `index` of the window (a repeated identifier keeps its last line)
+static inline void ventana_coloca(BancoSemillas *banco, size_t index, const RegistroStreaming *registro) {
+    if (banco->vCategorias[index] == SLOT_VACIO) banco->n_vivas++;
+    if (index >= banco->n_semillas) banco->n_semillas = index + 1;
+
+    banco->vAnyo[index] = registro->anyo;
+    banco->vCaducidad[index] = registro->caducidad;
+    banco->vNumSemillas[index] = registro->num_semillas;
+    banco->vSeccion[index] = registro->seccion;
+    banco->vCategorias[index] = registro->categorias;
+}
+
+//* Empties the slots of the previous window and makes the window start after id_base
+static void ventana_vacia(VentanaStreaming *ventana, size_t id_base) {
+    BancoSemillas *banco = ventana->banco;
+
+    void **columnas[N_COLUMNAS];
+    banco_columnas(banco, columnas);
+    for (int c = 0; c < N_COLUMNAS; c++) memset(*columnas[c], 0, banco->n_semillas * tam_columnas[c]);
+
+    banco->n_semillas = 0;
+    banco->n_vivas = 0;
+    banco->id_base = id_base;
+}
+
+//* Reads (escribe false) or writes len bytes of the spill file at `pos`, retrying short transfers
+static int reparto_transfiere(VentanaStreaming *ventana, void *datos, size_t len, off_t pos, bool escribe) {
+    int fd = fileno(ventana->reparto);
+    char *p = datos;
+
+    while (len > 0) {
+        ssize_t n = escribe ? pwrite(fd, p, len, pos) : pread(fd, p, len, pos);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+
+        p += n;
+        pos += n;
+        len -= n;
+    }
+    return 0;
+}
+
+//* Adds a run of n records at `inicio` of the spill file to the window w
+static int reparto_anota(VentanaStreaming *ventana, size_t w, off_t inicio, size_t n) {
+    if (w >= ventana->n_ventanas) {
+        RepartoVentana *nuevas = realloc(ventana->ventanas, (w + 1) * sizeof(RepartoVentana));
+        if (nuevas == NULL) return -1;
+
+        memset(nuevas + ventana->n_ventanas, 0, (w + 1 - ventana->n_ventanas) * sizeof(RepartoVentana));
+        ventana->ventanas = nuevas;
+        ventana->n_ventanas = w + 1;
+    }
+
+    RepartoVentana *reparto = &ventana->ventanas[w];
+
+    if (reparto->n_rachas == reparto->cap_rachas) {
+        size_t cap = reparto->cap_rachas > 0 ? reparto->cap_rachas * 2 : 8;
+        void *nuevas = realloc(reparto->rachas, cap * sizeof(*reparto->rachas));
+        if (nuevas == NULL) return -1;
+
+        reparto->rachas = nuevas;
+        reparto->cap_rachas = cap;
+    }
+
+    reparto->rachas[reparto->n_rachas].inicio = inicio;
+    reparto->rachas[reparto->n_rachas].n = n;
+    reparto->n_rachas++;
+    return 0;
+}
+
+//* Writes the pending records to the spill file, grouped by window with a stable counting sort
+//* (each window gets one run, and inside it the records keep the order of the file)
+static int reparto_vuelca(VentanaStreaming *ventana) {
+    if (ventana->n_pendientes == 0) return 0;
+
+    size_t n_ventanas = (ventana->id_max + ventana->n_slots - 1) / ventana->n_slots;
+    size_t *inicio = calloc(2 * (n_ventanas + 1), sizeof(size_t));
+    if (inicio == NULL) return -1;
+    size_t *cursor = inicio + n_ventanas + 1;
+
+    for (size_t j = 0; j < ventana->n_pendientes; j++) inicio[(ventana->pendientes[j].id - 1) / ventana->n_slots + 1]++;
+    for (size_t w = 0; w < n_ventanas; w++) inicio[w + 1] += inicio[w];
+    memcpy(cursor, inicio, (n_ventanas + 1) * sizeof(size_t));
+
+    for (size_t j = 0; j < ventana->n_pendientes; j++) {
+        size_t w = (ventana->pendientes[j].id - 1) / ventana->n_slots;
+        ventana->repartidos[cursor[w]++] = ventana->pendientes[j];
+    }
+
+    int resultado = reparto_transfiere(ventana, ventana->repartidos, ventana->n_pendientes * sizeof(RegistroStreaming),
+                                       ventana->fin_reparto, true);
+
+    for (size_t w = 0; w < n_ventanas && resultado == 0; w++) {
+        size_t n = inicio[w + 1] - inicio[w];
+        if (n > 0) resultado = reparto_anota(ventana, w, ventana->fin_reparto + (off_t) (inicio[w] * sizeof(RegistroStreaming)), n);
+    }
+
+    ventana->fin_reparto += ventana->n_pendientes * sizeof(RegistroStreaming);
+    ventana->n_pendientes = 0;
+    free(inicio);
+    return resultado;
+}
+
+//* Keeps the record of a line beyond the first window until it is written to the spill file
+static int reparto_anyade(VentanaStreaming *ventana, const RegistroStreaming *registro) {
+    if (ventana->reparto == NULL) {
+        ventana->pendientes = malloc(ventana->cap_pendientes * sizeof(RegistroStreaming));
+        ventana->repartidos = malloc(ventana->cap_pendientes * sizeof(RegistroStreaming));
+        ventana->reparto = tmpfile();
+        if (ventana->pendientes == NULL || ventana->repartidos == NULL || ventana->reparto == NULL) return -1;
+    }
+
+    if (ventana->n_pendientes == ventana->cap_pendientes && reparto_vuelca(ventana) == -1) return -1;
+
+    ventana->pendientes[ventana->n_pendientes++] = *registro;
+    return 0;
+}
+
+//* Frees the spill file and its runs
+static void reparto_libera(VentanaStreaming *ventana) {
+    if (ventana->reparto != NULL) fclose(ventana->reparto);
+    for (size_t w = 0; w < ventana->n_ventanas; w++) free(ventana->ventanas[w].rachas);
+
+    free(ventana->ventanas);
+    free(ventana->pendientes);
+    free(ventana->repartidos);
+}
+
+//* Parses the complete lines of [p, fin): those of the first window go to their slots and the
+//* rest to the spill file. Returns -2 if a line has values out of range (the same rules as
+//* lee_datos) and -1 if the spill file cannot be written.
+static int ventana_parsea(VentanaStreaming *ventana, const char *p, const char *fin) {
+    int campos[10];
+
+    while (!ventana->fin_datos) {
+        int leidos = 0;
+        while (leidos < 10 && lee_entero(&p, fin, &campos[leidos])) leidos++;
+
+        if (leidos < 10) {
+            // Like lee_datos, the data ends at the first incomplete line
+            if (leidos > 0 || p != fin) ventana->fin_datos = true;
+            return 0;
+        }
+
+        if (!campos_validos(campos)) return -2;
+
+        if ((size_t) campos[0] > ventana->id_max) ventana->id_max = campos[0];
+
+        RegistroStreaming registro = {
+            .id = campos[0], .anyo = campos[1], .caducidad = campos[2], .num_semillas = campos[3],
+            .categorias = EMPAQUETA(campos[5], campos[6], campos[7], campos[8], campos[9]), .seccion = campos[4]
+        };
+
+        size_t index = (size_t) campos[0] - 1;
+
+        if (index < ventana->n_slots) ventana_coloca(ventana->banco, index, &registro);
+        else if (reparto_anyade(ventana, &registro) == -1) return -1;
+    }
+
+    return 0;
+}
+
+//* Last line break of a block (NULL if there is none)
+static const char *ultimo_salto_de_linea(const char *bloque, size_t n) {
+    while (n > 0) {
+        if (bloque[--n] == '\n') return bloque + n;
+    }
+    return NULL;
+}
+
+//* Function to read semillas.txt once: fills the first window of identifiers [1, n_slots] and
+//* leaves the lines of the others in the spill file. The blocks are parsed up to their last line
+//* break and the cut line is carried over to the next block. Returns -1 if the file cannot be read,
+//* -2 if it has invalid data and -4 if a line is longer than MAX_LINEA_STREAMING.
+static int ventana_carga(VentanaStreaming *ventana, const char *ruta, char *bloques[2], size_t tam_bloque) {
+    BancoSemillas *banco = ventana->banco;
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_VENTANA);
+
+    ventana_vacia(ventana, 0);
+    ventana->fin_datos = false;
+
+    LectorBloques lector;
+    if (lector_abre(&lector, ruta, bloques, tam_bloque) == -1) return -1;
+
+    char resto[MAX_LINEA_STREAMING]; // Line cut at the end of the previous block
+    size_t n_resto = 0;
+    int resultado = 0;
+
+    while (resultado == 0 && !ventana->fin_datos) {
+        const char *bloque;
+        ssize_t leidos = lector_siguiente(&lector, &bloque);
+
+        if (leidos == -1) resultado = -1;
+        if (leidos <= 0) break;
+
+        const char *fin = bloque + leidos;
+        const char *primer_salto = memchr(bloque, '\n', leidos);
+        const char *ultimo_salto = ultimo_salto_de_linea(bloque, leidos);
+
+        if (primer_salto == NULL) {
+            // The block is in the middle of one line
+            if (n_resto + leidos > sizeof(resto)) resultado = -4;
+            else memcpy(resto + n_resto, bloque, leidos);
+            n_resto += leidos;
+        } else {
+            // Complete the cut line, then every full line of the block
+            size_t cabeza = primer_salto + 1 - bloque;
+
+            if (n_resto + cabeza > sizeof(resto)) {
+                resultado = -4;
+            } else {
+                memcpy(resto + n_resto, bloque, cabeza);
+                resultado = ventana_parsea(ventana, resto, resto + n_resto + cabeza);
+            }
+
+            if (resultado == 0) resultado = ventana_parsea(ventana, primer_salto + 1, ultimo_salto + 1);
+
+            n_resto = fin - (ultimo_salto + 1);
+            if (n_resto > sizeof(resto)) resultado = -4;
+            else memcpy(resto, ultimo_salto + 1, n_resto);
+        }
+
+        lector_devuelve(&lector);
+    }
+
+    // Last line without a line break
+    if (resultado == 0 && n_resto > 0) resultado = ventana_parsea(ventana, resto, resto + n_resto);
+
+    lector_cierra(&lector);
+
+    if (resultado == 0 && ventana->reparto != NULL) resultado = reparto_vuelca(ventana);
+
+    tramo_cierra(&tramo, banco->n_semillas, banco->n_vivas);
+    return resultado;
+}
+
+//* Function to fill the window w from its runs of the spill file, read through `bloque`
+//* Returns -1 if the spill file cannot be read
+static int ventana_recarga(VentanaStreaming *ventana, size_t w, char *bloque, size_t tam_bloque) {
+    BancoSemillas *banco = ventana->banco;
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_VENTANA);
+
+    ventana_vacia(ventana, w * ventana->n_slots);
+
+    RegistroStreaming *registros = (RegistroStreaming *) bloque;
+    size_t caben = tam_bloque / sizeof(RegistroStreaming);
+    int resultado = 0;
+
+    for (size_t r = 0; w < ventana->n_ventanas && r < ventana->ventanas[w].n_rachas && resultado == 0; r++) {
+        off_t pos = ventana->ventanas[w].rachas[r].inicio;
+        size_t pendientes = ventana->ventanas[w].rachas[r].n;
+
+        while (pendientes > 0 && resultado == 0) {
+            size_t n = pendientes < caben ? pendientes : caben;
+            resultado = reparto_transfiere(ventana, registros, n * sizeof(RegistroStreaming), pos, false);
+
+            for (size_t j = 0; j < n && resultado == 0; j++) ventana_coloca(banco, registros[j].id - 1 - banco->id_base, &registros[j]);
+
+            pos += n * sizeof(RegistroStreaming);
+            pendientes -= n;
+        }
+    }
+
+    tramo_cierra(&tramo, banco->n_semillas, banco->n_vivas);
+    return resultado;
+}
+
+//* Writes the seeds of the loaded window to the spill file as its only run, so it can be
+//* loaded again with ventana_recarga (the first window never went through the spill file)
+static int ventana_guarda(VentanaStreaming *ventana, char *bloque, size_t tam_bloque) {
+    BancoSemillas *banco = ventana->banco;
+    size_t w = banco->id_base / ventana->n_slots;
+
+    if (ventana->reparto == NULL && (ventana->reparto = tmpfile()) == NULL) return -1;
+    if (w < ventana->n_ventanas) ventana->ventanas[w].n_rachas = 0;
+
+    RegistroStreaming *registros = (RegistroStreaming *) bloque;
+    size_t caben = tam_bloque / sizeof(RegistroStreaming), n = 0;
+    int resultado = 0;
+
+    for (size_t i = 0; i <= banco->n_semillas && resultado == 0; i++) {
+        // Write the block when it is full or after the last slot
+        if (n == caben || (i == banco->n_semillas && n > 0)) {
+            resultado = reparto_transfiere(ventana, registros, n * sizeof(RegistroStreaming), ventana->fin_reparto, true);
+            if (resultado == 0) resultado = reparto_anota(ventana, w, ventana->fin_reparto, n);
+
+            ventana->fin_reparto += n * sizeof(RegistroStreaming);
+            n = 0;
+        }
+
+        if (i == banco->n_semillas || banco->vCategorias[i] == SLOT_VACIO) continue;
+
+        registros[n++] = (RegistroStreaming) {
+            .id = banco->id_base + i + 1, .anyo = banco->vAnyo[i], .caducidad = banco->vCaducidad[i],
+            .num_semillas = banco->vNumSemillas[i], .categorias = banco->vCategorias[i], .seccion = banco->vSeccion[i]
+        };
+    }
+
+    return resultado;
+}
+
+//* Function to run the four reports in streaming mode (./practica_8 --streaming inicio fin [MiB])
+//* Only one window of identifiers of the bank is in memory at a time. Its size comes from the
+//* memory budget (SEMILLAS_MEMORIA_MIB by default) minus the two read-ahead blocks. semillas.txt
+//* is read once: it fills the first window and the lines of the others go, grouped by window, to
+//* a temporary spill file. Each window goes through the same scans and writers as
+//* todos_los_informes, in identifier order, so the files and counts are the same. bioma.txt
+//* needs the biome with most seeds first; when the bank takes more than one window its listing
+//* is written by a second round over the spill file.
+int streaming(int argc, char *argv[]) {
+
+    int start_year, end_year;
+
+    if (argc < 2 || argc > 3 || !lee_rango_lote(argv[0], argv[1], &start_year, &end_year)) {
+        fprintf(stderr, "Uso: --streaming anyo_inicio anyo_fin [memoria en MiB]\n");
+        return 1;
+    }
+
+    const char *valor = argc == 3 ? argv[2] : getenv("SEMILLAS_MEMORIA_MIB");
+    size_t memoria = (size_t) (valor != NULL && atol(valor) > 0 ? atol(valor) : MEMORIA_STREAMING_MIB) << 20;
+
+    size_t tam_bloque = memoria / 8 < TAM_BLOQUE_STREAMING ? memoria / 8 : TAM_BLOQUE_STREAMING;
+    size_t n_slots = (memoria - 2 * tam_bloque) / BYTES_POR_SLOT_STREAMING / 64 * 64;
+    if (n_slots < 64) n_slots = 64;
+
+    const char *rutas[] = {"caducadas.txt", "bioma.txt", "donadas.txt", "nodonadas.txt"};
+    Escritor salidas[4];
+
+    for (int f = 0; f < 4; f++) {
+        if (escritor_abre(&salidas[f], rutas[f]) == -1) {
+            while (--f >= 0) escritor_cierra(&salidas[f]);
+            fprintf(stderr, "Error: No se pudo crear los archivos");
+            return 1;
+        }
+    }
+
+    BancoSemillas banco;
+    char *bloques[2] = {malloc(tam_bloque), malloc(tam_bloque)};
+    int resultado = banco_inicializa(&banco);
+
+    if (resultado == 0) resultado = banco_reserva(&banco, n_slots);
+    if (bloques[0] == NULL || bloques[1] == NULL) resultado = -1;
+
+    // The records waiting for the spill file use the part of the budget of the expiration index and
+    // the donation bitmaps, which are only built once the text has been read
+    size_t bytes_columnas = 0;
+    for (int c = 0; c < N_COLUMNAS; c++) bytes_columnas += tam_columnas[c];
+
+    VentanaStreaming ventana = {.banco = &banco, .n_slots = n_slots};
+    ventana.cap_pendientes = n_slots * (BYTES_POR_SLOT_STREAMING - bytes_columnas) / (2 * sizeof(RegistroStreaming));
+    if (ventana.cap_pendientes < 1024) ventana.cap_pendientes = 1024;
+
+    Agregados total = {0};
+    size_t n_vivas = 0, n_ventanas = 0;
+
+    // The only pass over semillas.txt
+    if (resultado == 0) resultado = ventana_carga(&ventana, "semillas.txt", bloques, tam_bloque);
+
+    // Round 1: every report but the listing of bioma.txt
+    for (size_t w = 0; resultado == 0 && (w == 0 || w * n_slots < ventana.id_max); w++) {
+        if (w > 0) resultado = ventana_recarga(&ventana, w, bloques[0], tam_bloque);
+        if (resultado != 0) break;
+
+        n_ventanas++;
+        n_vivas += banco.n_vivas;
+
+        FiltroDonacion filtro;
+        IndiceCaducidad indice;
+
+        if (filtro_crea(&filtro, &banco) == -1) {
+            resultado = -1;
+            break;
+        }
+        if (indice_construye(&indice, &banco) == -1) {
+            filtro_libera(&filtro);
+            resultado = -1;
+            break;
+        }
+
+        Agregados ag = {0};
+        recorre_banco(&banco, TODOS_LOS_INFORMES, &filtro, &ag);
+        indice_cuenta(&indice, start_year, end_year, &ag);
+
+        suma_agregados(&total, &ag);
+        total.count_total_expired_seeds += ag.count_total_expired_seeds;
+        total.count_total_expired_seed_samples += ag.count_total_expired_seed_samples;
+        total.count_total_seed_samples += ag.count_total_seed_samples;
+
+        escribe_donacion(&banco, &filtro, &salidas[2], &salidas[3]);
+        if (escribe_caducadas(&banco, &indice, start_year, end_year, &salidas[0]) == -1) resultado = -1;
+
+        indice_libera(&indice);
+        filtro_libera(&filtro);
+
+        // The first window was never in the spill file; round 2 loads it from there too
+        if (resultado == 0 && w == 0 && ventana.id_max > n_slots) resultado = ventana_guarda(&ventana, bloques[0], tam_bloque);
+    }
+
+    // Round 2: the listing of the biome with most seeds (the last window is still loaded)
+    int bioma = bioma_mayor(&total);
+
+    if (resultado == 0 && n_ventanas == 1) {
+        escribe_bioma(&banco, bioma, &salidas[1]);
+    } else {
+        for (size_t w = 0; resultado == 0 && w * n_slots < ventana.id_max; w++) {
+            resultado = ventana_recarga(&ventana, w, bloques[0], tam_bloque);
+            if (resultado != 0) break;
+
+            if (w == 0) escribe_bioma(&banco, bioma, &salidas[1]);
+            else escribe_semillas_bioma(&banco, bioma, &salidas[1]);
+        }
+    }
+
+    reparto_libera(&ventana);
+    free(bloques[0]);
+    free(bloques[1]);
+    banco_libera(&banco);
+
+    for (int f = 0; f < 4; f++) {
+        if (escritor_cierra(&salidas[f]) == -1 && resultado == 0) resultado = -3;
+    }
+
+    fprintf(stderr, "Streaming: %zu semillas en %zu ventanas de %zu identificadores (%zu MiB)\n",
+            n_vivas, n_ventanas, n_slots, memoria >> 20);
+
+    if (resultado == -1) {
+        fprintf(stderr, "Error: No se pudo leer el archivo semillas.txt o no hay memoria suficiente\n");
+        return 1;
+    } else if (resultado == -2) {
+        fprintf(stderr, "Error: El archivo semillas.txt contiene datos fuera de rango\n");
+        return 1;
+    } else if (resultado == -3) {
+        fprintf(stderr, "Error: No se pudo crear los archivos");
+        return 1;
+    } else if (resultado == -4) {
+        fprintf(stderr, "Error: El archivo semillas.txt tiene lineas de mas de %d caracteres\n", MAX_LINEA_STREAMING);
+        return 1;
+    }
+
+    // Same output as todos_los_informes
+    printf("\n");
+    imprime_peligro_extincion(&total);
+
+    printf("\n\n");
+    int resultado_caducidad = imprime_caducidad(&total, n_vivas);
+
+    printf("\n");
+    imprime_bioma_mayor(&total, n_vivas);
+
+    printf("\n");
+    imprime_donacion(total.contadorDonadas, total.contadorNoDonadas, n_vivas);
+
+    return resultado_caducidad == -1 ? 1 : 0;
+}
+
+//* One bank of --sitios, loaded and reported on by its own thread
+typedef struct {
+    _Alignas(64) const char *ruta;   // Its semillas.txt
+    int numero;                      // Position on the command line, from 1
+    int start_year, end_year;
+    BancoSemillas banco;
+    FiltroDonacion filtro;
+    Agregados ag;                    // The four reports of this site only
+    Escritor listados[3];            // caducadas, donadas and nodonadas, kept in memory
+    int resultado;                   // 0, or the error of lee_datos (-1, -2) or -3 without memory
+} Sitio;
+
+//* Loads one site and computes its reports (the listings stay in memory until the merge)
+static void *sitio_procesa(void *arg) {
+    Sitio *sitio = arg;
+
+    Tramo tramo;
+    tramo_abre(&tramo, FASE_SITIO);
+
+    IndiceCaducidad indice;
+    bool con_banco = false, con_filtro = false, con_indice = false;
+
+    sitio->resultado = banco_inicializa(&sitio->banco) == 0 ? 0 : -3;
+    if (sitio->resultado == 0) {
+        con_banco = true;
+        sitio->resultado = lee_datos(&sitio->banco, sitio->ruta);
+    }
+    if (sitio->resultado == 0) {
+        con_filtro = filtro_crea(&sitio->filtro, &sitio->banco) == 0;
+        con_indice = con_filtro && indice_construye(&indice, &sitio->banco) == 0;
+        if (!con_indice) sitio->resultado = -3;
+    }
+    for (int f = 0; f < 3 && sitio->resultado == 0; f++) {
+        if (escritor_en_memoria(&sitio->listados[f]) == -1) sitio->resultado = -3;
+    }
+
+    if (sitio->resultado == 0) {
+        recorre_banco(&sitio->banco, TODOS_LOS_INFORMES, &sitio->filtro, &sitio->ag);
+        indice_cuenta(&indice, sitio->start_year, sitio->end_year, &sitio->ag);
+
+        escribe_donacion(&sitio->banco, &sitio->filtro, &sitio->listados[1], &sitio->listados[2]);
+        if (escribe_caducadas(&sitio->banco, &indice, sitio->start_year, sitio->end_year, &sitio->listados[0]) == -1) {
+            sitio->resultado = -3;
+        }
+    }
+
+    if (con_indice) indice_libera(&indice);
+    if (con_filtro) filtro_libera(&sitio->filtro);
+    if (sitio->resultado != 0 && con_banco) banco_libera(&sitio->banco);
+
+    tramo_cierra(&tramo, sitio->banco.n_semillas, sitio->banco.n_vivas);
+    return NULL;
+}
+
+//* Prints the four reports of a site or of the merge (same output as todos_los_informes)
+static int imprime_informes(const Agregados *ag, size_t n_vivas) {
+    printf("\n");
+    imprime_peligro_extincion(ag);
+
+    printf("\n\n");
+    int resultado = imprime_caducidad(ag, n_vivas);
+
+    printf("\n");
+    imprime_bioma_mayor(ag, n_vivas);
+
+    printf("\n");
+    imprime_donacion(ag->contadorDonadas, ag->contadorNoDonadas, n_vivas);
+
+    return resultado;
+}
+
+//* Writes the header of the part of one site in a consolidated listing
+static void escribe_cabecera_sitio(Escritor *file, const Sitio *sitio) {
+    ESCRIBE(file, "Sitio ");
+    escritor_entero(file, sitio->numero);
+    ESCRIBE(file, ": ");
+    escritor_texto(file, sitio->ruta, strlen(sitio->ruta));
+    ESCRIBE(file, "\n");
+}
+
+//* Writes the reports of one site to sitio<n>_caducadas.txt, sitio<n>_bioma.txt, ...
+static int escribe_sitio(const Sitio *sitio, const char *const rutas[4]) {
+    int resultado = 0;
+
+    for (int f = 0; f < 4; f++) {
+        char ruta[64];
+        snprintf(ruta, sizeof(ruta), "sitio%d_%s", sitio->numero, rutas[f]);
+
+        Escritor file;
+        if (escritor_abre(&file, ruta) == -1) return -1;
+
+        if (f == 1) escribe_bioma(&sitio->banco, bioma_mayor(&sitio->ag), &file);
+        else {
+            const Escritor *listado = &sitio->listados[f == 0 ? 0 : f - 1];
+            escritor_texto(&file, listado->buffer, listado->usado);
+        }
+
+        if (escritor_cierra(&file) == -1) resultado = -1;
+    }
+
+    return resultado;
+}
+
+//* Function to report on several banks at once (./practica_8 --sitios anyo_inicio anyo_fin fichero ...)
+//* Each file is a site with its own identifiers 1..N, loaded into its own bank by its own thread,
+//* which also computes the four reports of the site. The aggregates are then added up (the biome
+//* and growth type with most seeds at risk are chosen on the totals, not per site) and written:
+//* sitio<n>_*.txt for each site, and caducadas.txt, bioma.txt, donadas.txt and nodonadas.txt with
+//* the part of every site, in command line order, under a "Sitio <n>: <fichero>" line.
+int sitios(int argc, char *argv[]) {
+
+    int start_year, end_year;
+
+    if (argc < 3 || argc - 2 > MAX_SITIOS || !lee_rango_lote(argv[0], argv[1], &start_year, &end_year)) {
+        fprintf(stderr, "Uso: --sitios anyo_inicio anyo_fin fichero1 [fichero2 ...] (hasta %d ficheros)\n", MAX_SITIOS);
+        return 1;
+    }
+
+    int n_sitios = argc - 2;
+    Sitio *lista = calloc(n_sitios, sizeof(Sitio));
+    pthread_t *hilos = malloc(n_sitios * sizeof(pthread_t));
+
+    if (lista == NULL || hilos == NULL) {
+        free(lista);
+        free(hilos);
+        fprintf(stderr, "Error: No hay memoria suficiente para el banco de semillas\n");
+        return 1;
+    }
+
+    // The sites already run side by side: the threads of each scan are shared among them
+    num_hilos = num_hilos / n_sitios > 1 ? num_hilos / n_sitios : 1;
+
+    for (int k = 0; k < n_sitios; k++) {
+        lista[k] = (Sitio) {.ruta = argv[k + 2], .numero = k + 1, .start_year = start_year, .end_year = end_year};
+
+        if (pthread_create(&hilos[k], NULL, sitio_procesa, &lista[k]) != 0) {
+            sitio_procesa(&lista[k]); // No more threads: this site runs on the main one
+            hilos[k] = pthread_self();
+        }
+    }
+
+    for (int k = 0; k < n_sitios; k++) {
+        if (!pthread_equal(hilos[k], pthread_self())) pthread_join(hilos[k], NULL);
+    }
+    free(hilos);
+
+    int resultado = 0;
+
+    for (int k = 0; k < n_sitios; k++) {
+        if (lista[k].resultado == -1) fprintf(stderr, "Error: No se pudo abrir el archivo %s\n", lista[k].ruta);
+        else if (lista[k].resultado == -2) fprintf(stderr, "Error: El archivo %s contiene datos fuera de rango\n", lista[k].ruta);
+        else if (lista[k].resultado == -3) fprintf(stderr, "Error: No hay memoria suficiente para el banco de %s\n", lista[k].ruta);
+
+        if (lista[k].resultado != 0) resultado = -1;
+    }
+
+    // Merge: the counts add up, and the winners are picked again on the totals
+    Agregados total = {0};
+    size_t n_vivas = 0;
+
+    for (int k = 0; k < n_sitios && resultado == 0; k++) {
+        const Agregados *ag = &lista[k].ag;
+
+        suma_agregados(&total, ag);
+        total.count_total_expired_seeds += ag->count_total_expired_seeds;
+        total.count_total_expired_seed_samples += ag->count_total_expired_seed_samples;
+        total.count_total_seed_samples += ag->count_total_seed_samples;
+        n_vivas += lista[k].banco.n_vivas;
+    }
+
+    const char *const rutas[] = {"caducadas.txt", "bioma.txt", "donadas.txt", "nodonadas.txt"};
+    Escritor salidas[4];
+    int abiertas = 0;
+
+    while (resultado == 0 && abiertas < 4) {
+        if (escritor_abre(&salidas[abiertas], rutas[abiertas]) == -1) resultado = -3;
+        else abiertas++;
+    }
+
+    if (resultado == 0) {
+        int bioma = bioma_mayor(&total);
+
+        ESCRIBE(&salidas[1], "Semillas del bioma ");
+        escritor_texto(&salidas[1], bioma_names[bioma], strlen(bioma_names[bioma]));
+        ESCRIBE(&salidas[1], " \n\n");
+
+        for (int k = 0; k < n_sitios; k++) {
+            const Sitio *sitio = &lista[k];
+
+            for (int f = 0; f < 4; f++) escribe_cabecera_sitio(&salidas[f], sitio);
+
+            escritor_texto(&salidas[0], sitio->listados[0].buffer, sitio->listados[0].usado);
+            escribe_semillas_bioma(&sitio->banco, bioma, &salidas[1]);
+            escritor_texto(&salidas[2], sitio->listados[1].buffer, sitio->listados[1].usado);
+            escritor_texto(&salidas[3], sitio->listados[2].buffer, sitio->listados[2].usado);
+
+            if (escribe_sitio(sitio, rutas) == -1) resultado = -3;
+        }
+    }
+
+    while (abiertas > 0) {
+        if (escritor_cierra(&salidas[--abiertas]) == -1) resultado = -3;
+    }
+
+    if (resultado == -3) fprintf(stderr, "Error: No se pudo crear los archivos\n");
+
+    if (resultado == 0) {
+        for (int k = 0; k < n_sitios; k++) {
+            printf("\n=== Sitio %d: %s (%zu semillas) ===\n", lista[k].numero, lista[k].ruta, lista[k].banco.n_vivas);
+            if (imprime_informes(&lista[k].ag, lista[k].banco.n_vivas) == -1) resultado = -1;
+        }
+
+        printf("\n=== Total de %d sitios (%zu semillas) ===\n", n_sitios, n_vivas);
+        if (imprime_informes(&total, n_vivas) == -1) resultado = -1;
+    }
+
+    for (int k = 0; k < n_sitios; k++) {
+        for (int f = 0; f < 3; f++) free(lista[k].listados[f].buffer); // In-memory writers: nothing to flush
+        if (lista[k].resultado == 0) banco_libera(&lista[k].banco);
+    }
+    free(lista);
+
+    return resultado == 0 ? 0 : 1;
+}
+
+//* Next number of the splitmix64 generator (fast, and the same sequence on every machine)
+static uint64_t aleatorio(uint64_t *estado) {
+    uint64_t z = (*estado += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+//* Uniform number in [0, n) (multiply-shift instead of %, the bias is negligible for these n)
+static uint32_t aleatorio_hasta(uint64_t *estado, uint32_t n) {
+    return (uint32_t) (((aleatorio(estado) >> 32) * n) >> 32);
+}
+
+//* Function to write a synthetic inventory of `filas` seeds in the format of semillas.txt
+//* Identifiers are a shuffled 1..filas and every field is uniform over the ranges of the
+//* header of this file, like the real semillas.txt. The same `semilla` gives the same file.
+int genera_semillas(const char *ruta, size_t filas, uint64_t semilla) {
+
+    if (filas > UINT32_MAX) return -1;
+
+    uint32_t *ids = malloc((filas > 0 ? filas : 1) * sizeof(uint32_t));
+    if (ids == NULL) return -1;
+
+    uint64_t estado = semilla;
+
+    // Fisher-Yates shuffle of the identifiers
+    for (size_t j = 0; j < filas; j++) ids[j] = (uint32_t) j + 1;
+    for (size_t j = filas; j > 1; j--) {
+        size_t k = aleatorio_hasta(&estado, (uint32_t) j);
+        uint32_t tmp = ids[j - 1];
+        ids[j - 1] = ids[k];
+        ids[k] = tmp;
+    }
+
+    Escritor file;
+    if (escritor_abre(&file, ruta) == -1) {
+        free(ids);
+        return -1;
+    }
+
+    for (size_t j = 0; j < filas; j++) {
+        int anyo = 2020 + aleatorio_hasta(&estado, 5);
+
+        int campos[10] = {
+            (int) ids[j],
+            anyo,
+            anyo + 1 + aleatorio_hasta(&estado, 99),                // Expires 1 to 99 years after entering
+            aleatorio_hasta(&estado, 5000),                         // Sample of 0 to 4999 seeds
+            1 + aleatorio_hasta(&estado, N_SECCIONES),
+            RIESGO_EXTREMO + aleatorio_hasta(&estado, SIN_RIESGO),
+            ARBOL + aleatorio_hasta(&estado, PLANTA_TREPADORA),
+            CON_FLORES + aleatorio_hasta(&estado, SIN_FLORES),
+            DESERTICAS + aleatorio_hasta(&estado, OTROS),
+            ANUALES + aleatorio_hasta(&estado, PERENNES)
+        };
+
+        for (int c = 0; c < 10; c++) {
+            if (c > 0) ESCRIBE(&file, " ");
+            escritor_entero(&file, campos[c]);
+        }
+        ESCRIBE(&file, "\n");
+    }
+
+    free(ids);
+    return escritor_cierra(&file);
+}
+
+//* Loaded bank shared by the phases of the benchmark
+typedef struct {
+    const BancoSemillas *banco;
+    const IndiceCaducidad *indice;
+    const IndiceBitmaps *bitmaps;
+    const Cubo *cubo;
+} ContextoBenchmark;
+
+//* Risk counts rolled up from the cube, as peligro_extincion does
+static int bench_peligro(const ContextoBenchmark *ctx) {
+    Agregados ag = {0};
+    cubo_agregados(ctx->cubo, &ag);
+    return ag.count_total_riesgo_extremo >= 0 ? 0 : -1;
+}
+
+static int bench_caducidad(const ContextoBenchmark *ctx) {
+    Escritor file;
+    if (escritor_abre(&file, "/dev/null") == -1) return -1;
+
+    Agregados ag = {0};
+    indice_cuenta(ctx->indice, 2020, 2060, &ag);
+    int resultado = escribe_caducadas(ctx->banco, ctx->indice, 2020, 2060, &file);
+
+    if (escritor_cierra(&file) == -1) resultado = -1;
+    return resultado;
+}
+
+static int bench_bioma(const ContextoBenchmark *ctx) {
+    Escritor file;
+    if (escritor_abre(&file, "/dev/null") == -1) return -1;
+
+    // Biome counts from the cube, then the listing, as bioma does
+    Agregados ag = {0};
+    cubo_agregados(ctx->cubo, &ag);
+    escribe_bioma(ctx->banco, bioma_mayor(&ag), &file);
+
+    return escritor_cierra(&file);
+}
+
+static int bench_donacion(const ContextoBenchmark *ctx) {
+    Escritor _donadas, _nodonadas;
+    FiltroDonacion filtro;
+
+    if (escritor_abre(&_donadas, "/dev/null") == -1) return -1;
+    if (escritor_abre(&_nodonadas, "/dev/null") == -1 || filtro_crea(&filtro, ctx->banco) == -1) {
+        escritor_cierra(&_donadas);
+        escritor_cierra(&_nodonadas);
+        return -1;
+    }
+
+    Agregados ag;
+    recorre_banco(ctx->banco, INFORME_DONACION, &filtro, &ag);
+    escribe_donacion(ctx->banco, &filtro, &_donadas, &_nodonadas);
+    filtro_libera(&filtro);
+
+    int resultado = 0;
+    if (escritor_cierra(&_donadas) == -1) resultado = -1;
+    if (escritor_cierra(&_nodonadas) == -1) resultado = -1;
+    return resultado;
+}
+
+//* Extreme-risk perennial shrubs in biome 5
+static int bench_consulta(const ContextoBenchmark *ctx) {
+    Consulta consulta = {0};
+    consulta.valores[CAMPO_RIESGO] = 1u << (RIESGO_EXTREMO - 1);
+    consulta.valores[CAMPO_CRECIMIENTO] = 1u << (ARBUSTO - 1);
+    consulta.valores[CAMPO_CICLO] = 1u << (PERENNES - 1);
+    consulta.valores[CAMPO_BIOMA] = 1u << 4;
+
+    return consulta_cuenta(ctx->bitmaps, &consulta) <= ctx->banco->n_vivas ? 0 : -1;
+}
+
+//* A range of years by biome from the cube (batch command cubo caducidad=2020-2060 por=bioma)
+static int bench_cubo(const ContextoBenchmark *ctx) {
+    Consulta consulta = {0};
+    long long semillas[MAX_VALORES_CAMPO], muestras[MAX_VALORES_CAMPO];
+    cubo_agrupa(ctx->cubo, &consulta, CAMPO_BIOMA, 2020, 2060, semillas, muestras);
+
+    return semillas[0] >= 0 ? 0 : -1;
+}
+
+//* The full scan for the risk and biome counts that the cube replaced, kept as a reference
+static int bench_recorrido(const ContextoBenchmark *ctx) {
+    Agregados ag;
+    recorre_banco(ctx->banco, INFORME_PELIGRO | INFORME_BIOMA, NULL, &ag);
+    return ag.count_total_riesgo_extremo >= 0 ? 0 : -1;
+}
+
+//* Prints the time of one phase of the benchmark over `filas` seeds
+static void imprime_fase(const char *fase, double segundos, size_t filas) {
+    printf("    %-10s %12.3f ms %10.2f ns/fila %14.0f filas/s\n", fase, segundos * 1000,
+           filas > 0 ? segundos * 1e9 / filas : 0.0, segundos > 0 ? filas / segundos : 0.0);
+}
+
+//* Runs the benchmark on one synthetic bank of `filas` seeds
+static int benchmark_tamanyo(size_t filas, uint64_t semilla) {
+
+    static const struct {
+        const char *nombre;
+        int (*fase)(const ContextoBenchmark *ctx);
+    } fases[] = {
+        {"peligro", bench_peligro},
+        {"caducidad", bench_caducidad},
+        {"bioma", bench_bioma},
+        {"donacion", bench_donacion},
+        {"consulta", bench_consulta},
+        {"cubo", bench_cubo},
+        {"recorrido", bench_recorrido}
+    };
+
+    printf("\n%zu filas (semilla %llu, %d hilos)\n", filas, (unsigned long long) semilla, hilos_para(filas));
+
+    double t = reloj_segundos();
+    if (genera_semillas(BENCH_FICHERO, filas, semilla) == -1) {
+        fprintf(stderr, "Error: No se pudo generar el archivo %s\n", BENCH_FICHERO);
+        return -1;
+    }
+    imprime_fase("genera", reloj_segundos() - t, filas);
+
+    BancoSemillas banco;
+    IndiceCaducidad indice;
+    IndiceBitmaps bitmaps;
+    Cubo cubo;
+
+    if (banco_inicializa(&banco) == -1) {
+        unlink(BENCH_FICHERO);
+        return -1;
+    }
+
+    t = reloj_segundos();
+    int resultado = lee_datos(&banco, BENCH_FICHERO);
+    imprime_fase("lee_datos", reloj_segundos() - t, filas);
+    unlink(BENCH_FICHERO);
+
+    if (resultado != 0) {
+        banco_libera(&banco);
+        return -1;
+    }
+
+    t = reloj_segundos();
+    if (indice_construye(&indice, &banco) == -1) {
+        banco_libera(&banco);
+        return -1;
+    }
+    if (bitmaps_construye(&bitmaps, &banco) == -1) {
+        indice_libera(&indice);
+        banco_libera(&banco);
+        return -1;
+    }
+    imprime_fase("indices", reloj_segundos() - t, filas);
+
+    // Built once; peligro, bioma and cubo are answered from it
+    t = reloj_segundos();
+    if (cubo_construye(&cubo, &banco) == -1) {
+        bitmaps_libera(&bitmaps);
+        indice_libera(&indice);
+        banco_libera(&banco);
+        return -1;
+    }
+    imprime_fase("crea_cubo", reloj_segundos() - t, filas);
+
+    ContextoBenchmark ctx = {&banco, &indice, &bitmaps, &cubo};
+
+    // Every report runs BENCH_REPETICIONES times and the fastest run is printed
+    for (size_t f = 0; f < sizeof(fases) / sizeof(fases[0]) && resultado == 0; f++) {
+        double mejor = 0;
+
+        for (int r = 0; r < BENCH_REPETICIONES && resultado == 0; r++) {
+            t = reloj_segundos();
+            resultado = fases[f].fase(&ctx);
+            t = reloj_segundos() - t;
+            if (r == 0 || t < mejor) mejor = t;
+        }
+
+        imprime_fase(fases[f].nombre, mejor, filas);
+    }
+
+    cubo_libera(&cubo);
+    bitmaps_libera(&bitmaps);
+    indice_libera(&indice);
+    banco_libera(&banco);
+    return resultado;
+}
+
+//* Runs benchmark_tamanyo in a child process and prints the memory peak of that child alone
+//* (the peak of this process would be the one of the biggest size so far)
+static int benchmark_en_hijo(size_t filas, uint64_t semilla) {
+    int canal[2];
+    if (pipe(canal) == -1) return -1;
+
+    fflush(stdout); // Otherwise the child would print the buffered text again
+    pid_t hijo = fork();
+
+    if (hijo == -1) {
+        close(canal[0]);
+        close(canal[1]);
+        return -1;
+    }
+
+    if (hijo == 0) {
+        close(canal[0]);
+        if (metricas.fd_contadores[0] != -1) abre_contadores();
+
+        int resultado = benchmark_tamanyo(filas, semilla);
+
+        fflush(stdout);
+        envia_metricas(canal[1]);
+        _exit(resultado == 0 ? 0 : 1); // Without atexit: the parent dumps the instrumentation
+    }
+
+    close(canal[1]);
+    recibe_metricas(canal[0]);
+    close(canal[0]);
+
+    int estado;
+    struct rusage uso;
+    if (wait4(hijo, &estado, 0, &uso) == -1 || !WIFEXITED(estado) || WEXITSTATUS(estado) != 0) return -1;
+
+    printf("    Pico de memoria (RSS): %.1f MiB\n", uso.ru_maxrss / 1024.0); // ru_maxrss is in KiB
+    return 0;
+}
+
+//* Function to run the benchmark over synthetic banks (./practica_8 --benchmark [filas ...])
+//* Each size is generated, loaded with lee_datos and run through every report in its own child
+//* process, writing the report files to /dev/null. Without sizes it runs 10K, 100K, 1M and 10M seeds.
+//* SEMILLAS_RNG changes the seed of the generator.
+int benchmark(int argc, char *argv[]) {
+
+    static const size_t tamanyos_por_defecto[] = {10000, 100000, 1000000, 10000000};
+
+    const char *valor = getenv("SEMILLAS_RNG");
+    uint64_t semilla = valor != NULL ? strtoull(valor, NULL, 10) : BENCH_SEMILLA;
+
+    size_t n_tamanyos = argc > 0 ? (size_t) argc : sizeof(tamanyos_por_defecto) / sizeof(tamanyos_por_defecto[0]);
+
+    for (size_t j = 0; j < n_tamanyos; j++) {
+        size_t filas = tamanyos_por_defecto[j < 4 ? j : 0];
+
+        if (argc > 0) {
+            char *fin;
+            unsigned long long n = strtoull(argv[j], &fin, 10);
+
+            if (*fin != '\0' || n < 1 || n > BENCH_MAX_FILAS) {
+                fprintf(stderr, "Error: El numero de filas debe estar entre 1 y %d\n", BENCH_MAX_FILAS);
+                return 1;
+            }
+            filas = n;
+        }
+
+        if (benchmark_en_hijo(filas, semilla) == -1) {
+            fprintf(stderr, "Error: El benchmark de %zu filas ha fallado\n", filas);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//* Function to write a synthetic inventory (./practica_8 --genera filas [fichero] [semilla])
+int genera(int argc, char *argv[]) {
+
+    char *fin = "";
+    unsigned long long filas = argc > 0 ? strtoull(argv[0], &fin, 10) : 0;
+
+    if (argc < 1 || *fin != '\0' || filas < 1 || filas > BENCH_MAX_FILAS) {
+        fprintf(stderr, "Uso: --genera filas [fichero] [semilla] (filas entre 1 y %d)\n", BENCH_MAX_FILAS);
+        return 1;
+    }
+
+    const char *ruta = argc > 1 ? argv[1] : BENCH_FICHERO;
+    uint64_t semilla = argc > 2 ? strtoull(argv[2], NULL, 10) : BENCH_SEMILLA;
+
+    if (genera_semillas(ruta, filas, semilla) == -1) {
+        fprintf(stderr, "Error: No se pudo generar el archivo %s\n", ruta);
+        return 1;
+    }
+
+    return 0;
+}
+
+//* Menu function with input validation
+void menu(int *memory_of_menu_option) {
+
+        printf("\n\n");
+        printf("--------------- Menu de opciones -----------------------\n");
+        printf("1. Semillas de especies en peligro de extincion.\n");
+        printf("2. Caducidad de semillas.\n");
+        printf("3. Bioma con mayor porcentaje de especies en el banco.\n");
+        printf("4. Donacion de semillas.\n");
+        printf("5. Todos los informes.\n");
+        printf("6. Consulta por categorias.\n");
+        printf("7. Aplicar cambios (fichero delta).\n");
+        printf("8. Tablas de conteo.\n");
         printf("0. Finalizar.\n");
         printf("---------------------------------------------------------\n");
-        printf("Elige una opcion (0-4): ");
+        printf("Elige una opcion (0-8): ");
 
+        int leidos = scanf("%d", memory_of_menu_option);
+
+        // Without more input (e.g. keystrokes piped by a script) the program ends
+        if (leidos == EOF) {
+            *memory_of_menu_option = 0;
+        }
         // Check if input is valid
-        if (scanf("%d", memory_of_menu_option) != 1) {
+        else if (leidos != 1) {
             *memory_of_menu_option = -1; // Assign an invalid value if input is not a number
             while (getchar() != '\n');   // Clear the input buffer
         }